@@ -0,0 +1,248 @@
+/*
+ * HiSH in-process display hook
+ *
+ * libqemu runs inside the HiSH app process. Instead of encoding the console
+ * through the VNC server and decoding it again on the other end of a loopback
+ * socket, the app attaches HishDisplayOps here and reads the pixman surface
+ * directly. The ABI lives in include/ui/hish-display.h, copied from the app
+ * tree (feature/hish_main/src/main/cpp/include/hish_display.h) at build time.
+ *
+ * It also lets the app hand the VNC server one end of a socketpair, so the
+ * input connection needs neither TCP nor a listening port.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/error-report.h"
+#include "qemu/main-loop.h"
+#include "qemu/thread.h"
+#include "block/aio.h"
+#include "qapi/qapi-commands-ui.h"
+#include "ui/console.h"
+#include "ui/hish-display.h"
+
+#define HISH_EXPORT __attribute__((visibility("default")))
+
+/* Guards hish_ops/hish_opaque/hish_dirty; held across every app callback */
+static QemuMutex hish_lock;
+static const HishDisplayOps *hish_ops;
+static void *hish_opaque;
+static bool hish_dirty;
+
+/* Main loop only */
+static bool hish_registered;
+static DisplayChangeListener hish_dcl;
+
+static void __attribute__((constructor)) hish_display_init_lock(void)
+{
+    qemu_mutex_init(&hish_lock);
+}
+
+static int hish_format(pixman_format_code_t format)
+{
+    switch (format) {
+    case PIXMAN_x8r8g8b8:
+    case PIXMAN_a8r8g8b8:
+        return HISH_DISPLAY_FORMAT_BGRX8888;
+    case PIXMAN_r5g6b5:
+        return HISH_DISPLAY_FORMAT_RGB565;
+    default:
+        return HISH_DISPLAY_FORMAT_NONE;
+    }
+}
+
+/* Called with hish_lock held */
+static void hish_send_switch(DisplaySurface *surface)
+{
+    int format;
+
+    if (!hish_ops) {
+        return;
+    }
+    format = surface ? hish_format(surface_format(surface)) : HISH_DISPLAY_FORMAT_NONE;
+    if (format == HISH_DISPLAY_FORMAT_NONE) {
+        hish_ops->surface_switch(hish_opaque, NULL, 0, 0, 0, format);
+        return;
+    }
+    hish_ops->surface_switch(hish_opaque, surface_data(surface),
+                             surface_width(surface), surface_height(surface),
+                             surface_stride(surface), format);
+    hish_ops->surface_update(hish_opaque, 0, 0,
+                             surface_width(surface), surface_height(surface));
+    hish_dirty = true;
+}
+
+static void hish_gfx_switch(DisplayChangeListener *dcl,
+                            DisplaySurface *new_surface)
+{
+    qemu_mutex_lock(&hish_lock);
+    hish_send_switch(new_surface);
+    qemu_mutex_unlock(&hish_lock);
+}
+
+static void hish_gfx_update(DisplayChangeListener *dcl,
+                            int x, int y, int w, int h)
+{
+    qemu_mutex_lock(&hish_lock);
+    if (hish_ops) {
+        hish_ops->surface_update(hish_opaque, x, y, w, h);
+        hish_dirty = true;
+    }
+    qemu_mutex_unlock(&hish_lock);
+}
+
+static void hish_refresh(DisplayChangeListener *dcl)
+{
+    graphic_hw_update(dcl->con);
+
+    qemu_mutex_lock(&hish_lock);
+    if (hish_ops && hish_dirty) {
+        hish_ops->refresh_done(hish_opaque);
+    }
+    hish_dirty = false;
+    qemu_mutex_unlock(&hish_lock);
+}
+
+static bool hish_check_format(DisplayChangeListener *dcl,
+                              pixman_format_code_t format)
+{
+    return hish_format(format) != HISH_DISPLAY_FORMAT_NONE;
+}
+
+static const DisplayChangeListenerOps hish_dcl_ops = {
+    .dpy_name             = "hish",
+    .dpy_refresh          = hish_refresh,
+    .dpy_gfx_update       = hish_gfx_update,
+    .dpy_gfx_switch       = hish_gfx_switch,
+    .dpy_gfx_check_format = hish_check_format,
+};
+
+static QemuConsole *hish_first_graphic_console(void)
+{
+    QemuConsole *con;
+    int i;
+
+    for (i = 0; (con = qemu_console_lookup_by_index(i)) != NULL; i++) {
+        if (qemu_console_is_graphic(con)) {
+            return con;
+        }
+    }
+    return NULL;
+}
+
+static bool hish_attached(void)
+{
+    bool attached;
+
+    qemu_mutex_lock(&hish_lock);
+    attached = hish_ops != NULL;
+    qemu_mutex_unlock(&hish_lock);
+    return attached;
+}
+
+/* BQL held */
+static void hish_attach_bh(void *opaque)
+{
+    QemuConsole *con;
+
+    if (!hish_attached()) {
+        return;
+    }
+    if (hish_registered) {
+        /* Replay the current surface for the new listener */
+        qemu_mutex_lock(&hish_lock);
+        hish_send_switch(qemu_console_surface(hish_dcl.con));
+        qemu_mutex_unlock(&hish_lock);
+        return;
+    }
+
+    con = hish_first_graphic_console();
+    if (!con) {
+        warn_report("hish-display: no graphic console");
+        return;
+    }
+    hish_dcl.ops = &hish_dcl_ops;
+    hish_dcl.con = con;
+    /* Calls dpy_gfx_switch with the current surface */
+    register_displaychangelistener(&hish_dcl);
+    hish_registered = true;
+}
+
+/* BQL held */
+static void hish_detach_bh(void *opaque)
+{
+    if (hish_registered && !hish_attached()) {
+        unregister_displaychangelistener(&hish_dcl);
+        hish_registered = false;
+    }
+}
+
+HISH_EXPORT int hish_display_attach(const HishDisplayOps *ops, void *opaque)
+{
+    AioContext *ctx = qemu_get_aio_context();
+
+    if (!ops || ops->abi_version != HISH_DISPLAY_ABI_VERSION ||
+        ops->size < sizeof(HishDisplayOps) || !ctx) {
+        return -1;
+    }
+
+    qemu_mutex_lock(&hish_lock);
+    hish_ops = ops;
+    hish_opaque = opaque;
+    qemu_mutex_unlock(&hish_lock);
+
+    aio_bh_schedule_oneshot(ctx, hish_attach_bh, NULL);
+    return 0;
+}
+
+HISH_EXPORT void hish_display_detach(void)
+{
+    AioContext *ctx = qemu_get_aio_context();
+
+    /* Callbacks run under hish_lock, so none is in flight after this */
+    qemu_mutex_lock(&hish_lock);
+    hish_ops = NULL;
+    hish_opaque = NULL;
+    hish_dirty = false;
+    qemu_mutex_unlock(&hish_lock);
+
+    /* Stop the refresh timer too; skipped if attached again meanwhile */
+    if (ctx) {
+        aio_bh_schedule_oneshot(ctx, hish_detach_bh, NULL);
+    }
+}
+
+#ifdef CONFIG_VNC
+/* BQL held */
+static void hish_vnc_add_client_bh(void *opaque)
+{
+    int fd = (int)(intptr_t)opaque;
+    VncInfo *info = qmp_query_vnc(NULL);
+    bool enabled = info && info->enabled;
+
+    qapi_free_VncInfo(info);
+    /* vnc_display_add_client() ignores the fd when there is no display */
+    if (!enabled) {
+        close(fd);
+        return;
+    }
+    vnc_display_add_client(NULL, fd, true);
+}
+#endif
+
+/* Without VNC compiled in the app falls back to TCP, which fails the same way */
+HISH_EXPORT int hish_vnc_add_client(int fd)
+{
+#ifdef CONFIG_VNC
+    AioContext *ctx = qemu_get_aio_context();
+
+    if (fd < 0 || !ctx) {
+        return -1;
+    }
+    aio_bh_schedule_oneshot(ctx, hish_vnc_add_client_bh, (void *)(intptr_t)fd);
+    return 0;
+#else
+    return -1;
+#endif
+}
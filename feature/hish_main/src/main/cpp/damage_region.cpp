@@ -0,0 +1,176 @@
+//
+// Damage Region Implementation for HiSH
+//
+
+#include "include/damage_region.hpp"
+#include <algorithm>
+
+bool DamageRect::contains(const DamageRect& o) const {
+    return o.x >= x && o.y >= y && o.x + o.w <= x + w && o.y + o.h <= y + h;
+}
+
+bool DamageRect::intersects(const DamageRect& o) const {
+    return !empty() && !o.empty() &&
+           o.x < x + w && x < o.x + o.w && o.y < y + h && y < o.y + o.h;
+}
+
+DamageRect DamageRect::intersection(const DamageRect& o) const {
+    int x1 = std::max(x, o.x);
+    int y1 = std::max(y, o.y);
+    int x2 = std::min(x + w, o.x + o.w);
+    int y2 = std::min(y + h, o.y + o.h);
+    if (x2 <= x1 || y2 <= y1) return DamageRect{0, 0, 0, 0};
+    return DamageRect{x1, y1, x2 - x1, y2 - y1};
+}
+
+DamageRect DamageRect::bounds(const DamageRect& o) const {
+    if (empty()) return o;
+    if (o.empty()) return *this;
+    int x1 = std::min(x, o.x);
+    int y1 = std::min(y, o.y);
+    int x2 = std::max(x + w, o.x + o.w);
+    int y2 = std::max(y + h, o.y + o.h);
+    return DamageRect{x1, y1, x2 - x1, y2 - y1};
+}
+
+// Pixels uploaded needlessly if a and b are replaced by their bounding box
+static int64_t mergeWaste(const DamageRect& a, const DamageRect& b) {
+    return a.bounds(b).area() - (a.area() + b.area() - a.intersection(b).area());
+}
+
+void DamageRegion::removeAt(int i) {
+    rects_[i] = rects_[count_ - 1];
+    count_--;
+}
+
+bool DamageRegion::overlapsOther(const DamageRect& r, int skip) const {
+    for (int i = 0; i < count_; i++) {
+        if (i != skip && rects_[i].intersects(r)) return true;
+    }
+    return false;
+}
+
+DamageRect DamageRegion::takeCheapestPair() {
+    int bestI = 0, bestJ = 1;
+    int64_t bestWaste = INT64_MAX;
+    for (int i = 0; i < count_; i++) {
+        for (int j = i + 1; j < count_; j++) {
+            int64_t waste = mergeWaste(rects_[i], rects_[j]);
+            if (waste < bestWaste) {
+                bestWaste = waste;
+                bestI = i;
+                bestJ = j;
+            }
+        }
+    }
+    DamageRect merged = rects_[bestI].bounds(rects_[bestJ]);
+    // Remove the higher index first so removeAt() does not move bestI
+    removeAt(bestJ);
+    removeAt(bestI);
+    return merged;
+}
+
+void DamageRegion::add(const DamageRect& rect) {
+    if (rect.empty()) return;
+
+    // Pending rectangles still to be placed. Splitting around an existing rect
+    // pushes up to four pieces; once the list overflows we stop splitting and
+    // only merge, which strictly shrinks the list and therefore terminates.
+    static constexpr int STACK_SIZE = 64;
+    DamageRect stack[STACK_SIZE];
+    int top = 0;
+    bool allowSplit = true;
+    stack[top++] = rect;
+
+    while (top > 0) {
+        DamageRect r = stack[--top];
+        bool placed = false;
+
+        for (int i = 0; i < count_ && !placed; i++) {
+            const DamageRect& e = rects_[i];
+            if (e.contains(r)) {
+                placed = true;
+                break;
+            }
+            if (r.contains(e)) {
+                removeAt(i);
+                i--;
+                continue;
+            }
+
+            bool overlap = e.intersects(r);
+            bool mustMerge = overlap && (!allowSplit || top + 4 >= STACK_SIZE);
+            // An optional merge must not swallow a third rect, otherwise a split
+            // piece could be merged straight back across it and loop forever.
+            if (mustMerge || (mergeWaste(e, r) <= RECT_COST_PIXELS && !overlapsOther(e.bounds(r), i))) {
+                // Bounding box is cheaper than two uploads (or we must keep the
+                // list disjoint without splitting): re-place the merged rect.
+                stack[top++] = e.bounds(r);
+                removeAt(i);
+                placed = true;
+                break;
+            }
+            if (overlap) {
+                // Keep only the parts of r outside e: top band, bottom band,
+                // then left/right pieces of the middle band.
+                DamageRect in = e.intersection(r);
+                DamageRect pieces[4] = {
+                    {r.x, r.y, r.w, in.y - r.y},
+                    {r.x, in.y + in.h, r.w, r.y + r.h - (in.y + in.h)},
+                    {r.x, in.y, in.x - r.x, in.h},
+                    {in.x + in.w, in.y, r.x + r.w - (in.x + in.w), in.h},
+                };
+                for (const DamageRect& p : pieces) {
+                    if (!p.empty()) stack[top++] = p;
+                }
+                placed = true;
+                break;
+            }
+        }
+        if (placed) continue;
+
+        if (count_ < MAX_RECTS) {
+            rects_[count_++] = r;
+            continue;
+        }
+
+        // List full: fold the cheapest pair and re-place both the union (it may
+        // now overlap other entries) and r, merging only from now on
+        allowSplit = false;
+        stack[top++] = r;
+        stack[top++] = takeCheapestPair();
+    }
+}
+
+void DamageRegion::add(const DamageRegion& other) {
+    for (const DamageRect& r : other) {
+        add(r);
+    }
+}
+
+void DamageRegion::clip(int width, int height) {
+    DamageRect screen{0, 0, width, height};
+    for (int i = 0; i < count_; i++) {
+        rects_[i] = rects_[i].intersection(screen);
+        if (rects_[i].empty()) {
+            removeAt(i);
+            i--;
+        }
+    }
+}
+
+DamageRect DamageRegion::bounds() const {
+    DamageRect b{0, 0, 0, 0};
+    for (const DamageRect& r : *this) {
+        b = b.bounds(r);
+    }
+    return b;
+}
+
+int64_t DamageRegion::area() const {
+    int64_t total = 0;
+    for (const DamageRect& r : *this) {
+        total += r.area();
+    }
+    return total;
+}
@@ -0,0 +1,167 @@
+//
+// In-process Display Bridge Implementation for HiSH
+//
+
+#include "include/display_bridge.hpp"
+#include "include/vnc_renderer.hpp"
+#include <dlfcn.h>
+#include "hilog/log.h"
+
+#undef LOG_DOMAIN
+#undef LOG_TAG
+#define LOG_DOMAIN 0x3304
+#define LOG_TAG "DisplayBridge"
+
+// Both libqemu variants startVM may have loaded (see getQemuSystemEntry)
+static const char* const QEMU_LIBRARIES[] = {
+    "libqemu-system-aarch64-tci.so",
+    "libqemu-system-aarch64.so",
+};
+
+const HishDisplayOps DisplayBridge::ops_ = {
+    HISH_DISPLAY_ABI_VERSION,
+    sizeof(HishDisplayOps),
+    DisplayBridge::onSurfaceSwitch,
+    DisplayBridge::onSurfaceUpdate,
+    DisplayBridge::onRefreshDone,
+};
+HishDisplayDetachFn DisplayBridge::detachFn_ = nullptr;
+std::atomic<bool> DisplayBridge::active_(false);
+
+std::mutex DisplayBridge::surfaceMutex_;
+VncFrame DisplayBridge::frame_ = {};
+std::atomic<uint64_t> DisplayBridge::seq_(0);
+std::atomic<int> DisplayBridge::frameWidth_(0);
+std::atomic<int> DisplayBridge::frameHeight_(0);
+DisplayResizeCallback DisplayBridge::resizeCallback_ = nullptr;
+
+uint64_t DisplayBridge::statRefreshes_ = 0;
+uint64_t DisplayBridge::statUpdates_ = 0;
+
+void* DisplayBridge::findQemuSymbol(const char* name) {
+    // Only look at a libqemu that is already loaded: the VM runs in this
+    // process, never in one we would load here
+    void* handle = nullptr;
+    for (const char* lib : QEMU_LIBRARIES) {
+        handle = dlopen(lib, RTLD_LAZY | RTLD_NOLOAD);
+        if (handle) break;
+    }
+    if (!handle) return nullptr;
+    void* sym = dlsym(handle, name);
+    // Drops only the RTLD_NOLOAD reference; startVM's handle keeps libqemu loaded
+    dlclose(handle);
+    return sym;
+}
+
+bool DisplayBridge::attach() {
+    if (active_.load(std::memory_order_acquire)) return true;
+
+    auto attachFn = reinterpret_cast<HishDisplayAttachFn>(findQemuSymbol(HISH_DISPLAY_ATTACH_SYMBOL));
+    auto detachFn = reinterpret_cast<HishDisplayDetachFn>(findQemuSymbol(HISH_DISPLAY_DETACH_SYMBOL));
+    if (!attachFn || !detachFn) {
+        OH_LOG_INFO(LOG_APP, "No in-process QEMU display hook, using VNC display");
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(surfaceMutex_);
+        frame_ = VncFrame{};
+    }
+    frameWidth_.store(0, std::memory_order_release);
+    frameHeight_.store(0, std::memory_order_release);
+    seq_.store(0, std::memory_order_release);
+    statRefreshes_ = 0;
+    statUpdates_ = 0;
+
+    // The current surface arrives through onSurfaceSwitch from the QEMU main loop
+    if (attachFn(&ops_, nullptr) != 0) {
+        OH_LOG_ERROR(LOG_APP, "hish_display_attach failed (ABI %{public}d)", HISH_DISPLAY_ABI_VERSION);
+        return false;
+    }
+    detachFn_ = detachFn;
+    active_.store(true, std::memory_order_release);
+    OH_LOG_INFO(LOG_APP, "Attached to in-process QEMU display");
+    return true;
+}
+
+void DisplayBridge::detach() {
+    if (!active_.load(std::memory_order_acquire)) return;
+
+    // Stop the renderer first: once the lock is ours no upload is in flight and
+    // acquireFrame() refuses the surface, so QEMU may free it after detachFn_
+    active_.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(surfaceMutex_);
+        frame_ = VncFrame{};
+    }
+
+    detachFn_();
+    detachFn_ = nullptr;
+    resizeCallback_ = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(surfaceMutex_);
+        frame_ = VncFrame{};
+    }
+    frameWidth_.store(0, std::memory_order_release);
+    frameHeight_.store(0, std::memory_order_release);
+
+    OH_LOG_INFO(LOG_APP, "Detached from QEMU display: refreshes=%{public}llu updates=%{public}llu",
+                static_cast<unsigned long long>(statRefreshes_), static_cast<unsigned long long>(statUpdates_));
+}
+
+void DisplayBridge::setResizeCallback(DisplayResizeCallback cb) {
+    resizeCallback_ = std::move(cb);
+}
+
+const VncFrame* DisplayBridge::acquireFrame() {
+    surfaceMutex_.lock();
+    frame_.seq = seq_.load(std::memory_order_acquire);
+    if (!active_.load(std::memory_order_acquire) || !frame_.data || frame_.seq == 0) {
+        surfaceMutex_.unlock();
+        return nullptr;
+    }
+    return &frame_;
+}
+
+void DisplayBridge::releaseFrame() {
+    surfaceMutex_.unlock();
+}
+
+void DisplayBridge::onSurfaceSwitch(void* opaque, void* data, int width, int height, int stride, int format) {
+    int bytesPerPixel = 0;
+    if (format == HISH_DISPLAY_FORMAT_BGRX8888) {
+        bytesPerPixel = 4;
+    } else if (format == HISH_DISPLAY_FORMAT_RGB565) {
+        bytesPerPixel = 2;
+    }
+
+    bool valid = data && bytesPerPixel > 0 && width > 0 && height > 0;
+    {
+        // Waits for an in-flight upload from the old surface
+        std::lock_guard<std::mutex> lock(surfaceMutex_);
+        frame_ = valid ? VncFrame{static_cast<uint8_t*>(data), width, height, bytesPerPixel,
+                                  static_cast<size_t>(stride), 0}
+                       : VncFrame{};
+    }
+
+    int oldWidth = frameWidth_.exchange(valid ? width : 0, std::memory_order_acq_rel);
+    int oldHeight = frameHeight_.exchange(valid ? height : 0, std::memory_order_acq_rel);
+    OH_LOG_INFO(LOG_APP, "QEMU surface: %{public}dx%{public}d stride=%{public}d format=%{public}d",
+                width, height, stride, format);
+
+    VncRenderer::resize(-1, -1);
+    if (valid && (oldWidth != width || oldHeight != height) && resizeCallback_) {
+        resizeCallback_(width, height);
+    }
+}
+
+void DisplayBridge::onSurfaceUpdate(void* opaque, int x, int y, int w, int h) {
+    statUpdates_++;
+    VncRenderer::markDirty(x, y, w, h);
+}
+
+void DisplayBridge::onRefreshDone(void* opaque) {
+    statRefreshes_++;
+    seq_.fetch_add(1, std::memory_order_release);
+}
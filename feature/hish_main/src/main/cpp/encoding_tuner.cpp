@@ -0,0 +1,165 @@
+//
+// Encoding Tuner Implementation for HiSH
+//
+
+#include "include/encoding_tuner.hpp"
+#include <algorithm>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/tcp.h>
+
+const EncodingProfile EncodingTuner::PROFILES[PROFILE_COUNT] = {
+    {"raw", "copyrect raw", 0, false},
+    {"hextile", "copyrect hextile raw", 0, false},
+    {"zrle-fast", "zrle copyrect hextile raw", 1, false},
+    {"zrle", "zrle ultra hextile zlib copyrect raw", 5, false},
+    {"tight", "tight zrle hextile zlib copyrect raw", 6, true},
+};
+
+// LIBVNCSERVER_HAVE_* come from CMake, as for libvncclient itself
+void EncodingTuner::reset(bool local) {
+    local_ = local;
+#if defined(LIBVNCSERVER_HAVE_LIBZ) && defined(LIBVNCSERVER_HAVE_LIBJPEG)
+    maxProfile_ = PROFILE_COUNT - 1;
+    profile_ = local ? 0 : 3;
+#elif defined(LIBVNCSERVER_HAVE_LIBZ)
+    maxProfile_ = PROFILE_COUNT - 2;    // libvncclient only builds Tight with libjpeg
+    profile_ = local ? 0 : 3;
+#else
+    maxProfile_ = 1;        // zlib based encodings are not compiled in
+    profile_ = local ? 0 : 1;
+#endif
+    quality_ = START_QUALITY;
+    capacityKbps_ = 0.0;
+    windowStart_ = std::chrono::steady_clock::now();
+    haveLink_ = false;
+    windowLink_ = {};
+    windowUpdates_ = 0;
+    windowPixels_ = 0;
+    windowNs_ = 0;
+    holdWindows_ = 0;
+    downLockout_ = 0;
+    lastStepDownFrom_ = -1;
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_ = {};
+    stats_.local = local;
+    stats_.profile = profile_;
+    stats_.qualityLevel = quality_;
+}
+
+// Fails on anything but TCP (e.g. the socketpair to the in-process QEMU)
+bool EncodingTuner::sampleLink(int sock, LinkSample& out) {
+    struct tcp_info info = {};
+    socklen_t len = sizeof(info);
+    if (sock < 0 || getsockopt(sock, IPPROTO_TCP, TCP_INFO, &info, &len) != 0) return false;
+    out.rttUs = info.tcpi_rtt;
+    out.minRttUs = info.tcpi_min_rtt;
+    out.bytesReceived = info.tcpi_bytes_received;
+    return true;
+}
+
+bool EncodingTuner::onUpdate(int sock, uint64_t pixels, uint64_t decodeNs) {
+    windowUpdates_++;
+    windowPixels_ += pixels;
+    windowNs_ += decodeNs;
+
+    auto now = std::chrono::steady_clock::now();
+    auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - windowStart_).count();
+    if (elapsedMs < WINDOW_MS || windowUpdates_ < MIN_WINDOW_UPDATES) return false;
+
+    LinkSample link = {};
+    bool haveLink = sampleLink(sock, link);
+    double decodeUsPerMpx = windowPixels_ > 0 ? (windowNs_ / 1000.0) / (windowPixels_ / 1e6) : 0.0;
+    double bytesPerPixel = 0.0;
+    double kbps = 0.0;
+    if (haveLink && haveLink_ && link.bytesReceived >= windowLink_.bytesReceived) {
+        uint64_t bytes = link.bytesReceived - windowLink_.bytesReceived;
+        bytesPerPixel = windowPixels_ > 0 ? static_cast<double>(bytes) / windowPixels_ : 0.0;
+        kbps = bytes * 8.0 / elapsedMs;
+    }
+
+    bool tuned = !local_ && haveLink;
+    int quality = quality_;
+    int next = tuned ? decide(link.rttUs, link.minRttUs, kbps, decodeUsPerMpx) : profile_;
+    bool changed = next != profile_ || quality_ != quality;
+
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        EncodingProfileStats& p = stats_.profiles[profile_];
+        // Smoothed, so one idle or one full-screen window does not dominate
+        const double alpha = p.updates == 0 ? 1.0 : 0.3;
+        p.updates += windowUpdates_;
+        p.pixels += windowPixels_;
+        p.decodeUsPerMpx += alpha * (decodeUsPerMpx - p.decodeUsPerMpx);
+        if (bytesPerPixel > 0) {
+            p.bytesPerPixel += (p.bytesPerPixel > 0 ? 0.3 : 1.0) * (bytesPerPixel - p.bytesPerPixel);
+        }
+        stats_.rttUs = haveLink ? link.rttUs : 0;
+        stats_.minRttUs = haveLink ? link.minRttUs : 0;
+        stats_.throughputKbps = kbps;
+        if (changed) {
+            stats_.switches++;
+        }
+        stats_.tuned = tuned;
+        stats_.profile = next;
+        stats_.qualityLevel = quality_;
+    }
+
+    windowStart_ = now;
+    windowLink_ = link;
+    haveLink_ = haveLink;
+    windowUpdates_ = 0;
+    windowPixels_ = 0;
+    windowNs_ = 0;
+
+    profile_ = next;
+    return changed;
+}
+
+// Next profile; may also move quality_
+int EncodingTuner::decide(uint32_t rttUs, uint32_t minRttUs, double kbps, double decodeUsPerMpx) {
+    bool queueing = minRttUs > 0 && rttUs > minRttUs + std::max(minRttUs, QUEUE_MIN_EXCESS_US);
+    // Queueing means the link is full: what got through is its capacity
+    if (queueing && kbps > capacityKbps_) {
+        capacityKbps_ = kbps;
+    }
+    if (holdWindows_ > 0) {
+        holdWindows_--;
+        return profile_;
+    }
+    if (downLockout_ > 0) {
+        downLockout_--;
+    }
+
+    if (queueing && profile_ < maxProfile_) {
+        // Back where the last step down came from: that step was a mistake
+        if (profile_ + 1 == lastStepDownFrom_) {
+            downLockout_ = DOWN_LOCKOUT_WINDOWS;
+        }
+        holdWindows_ = HOLD_WINDOWS;
+        return profile_ + 1;
+    }
+    if (queueing && PROFILES[profile_].lossy && quality_ > MIN_QUALITY) {
+        quality_ = std::max(MIN_QUALITY, quality_ - QUALITY_DOWN_STEP);
+        holdWindows_ = HOLD_WINDOWS;
+        return profile_;
+    }
+    if (!queueing && decodeUsPerMpx > CPU_BOUND_US_PER_MPX && profile_ > 0 && downLockout_ == 0) {
+        lastStepDownFrom_ = profile_;
+        holdWindows_ = HOLD_WINDOWS;
+        return profile_ - 1;
+    }
+    // Slow increase, fast decrease: settles just below where queueing starts
+    if (!queueing && PROFILES[profile_].lossy && quality_ < MAX_QUALITY &&
+        (capacityKbps_ == 0.0 || kbps < capacityKbps_ * QUALITY_HEADROOM)) {
+        quality_++;
+        holdWindows_ = HOLD_WINDOWS;
+    }
+    return profile_;
+}
+
+EncodingTunerStats EncodingTuner::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
@@ -0,0 +1,171 @@
+//
+// Triple-Buffered Framebuffer Exchange Implementation for HiSH
+//
+
+#include "include/frame_exchange.hpp"
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t roundUp(size_t size, size_t align) {
+    return (size + align - 1) / align * align;
+}
+
+// Reuses the slot's mapping when it is large enough (no clearing, see header)
+void FrameExchange::allocSlot(int index, int width, int height, int bytesPerPixel) {
+    VncFrame& slot = slots_[index];
+    size_t stride = static_cast<size_t>(width) * bytesPerPixel;
+    size_t size = stride * height;
+
+    if (!slot.data || size > capacity_[index]) {
+        freeSlot(index);
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t capacity = roundUp(size, size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : pageSize);
+        void* mem = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            slot = VncFrame{};
+            return;
+        }
+        if (capacity >= HUGE_PAGE_SIZE) {
+            madvise(mem, capacity, MADV_HUGEPAGE);      // best effort
+        }
+        slot.data = static_cast<uint8_t*>(mem);
+        capacity_[index] = capacity;
+    }
+    slot.width = width;
+    slot.height = height;
+    slot.bytesPerPixel = bytesPerPixel;
+    slot.stride = stride;
+    slot.seq = 0;
+}
+
+void FrameExchange::freeSlot(int index) {
+    if (slots_[index].data) {
+        munmap(slots_[index].data, capacity_[index]);
+    }
+    slots_[index] = VncFrame{};
+    capacity_[index] = 0;
+}
+
+uint8_t* FrameExchange::resize(int width, int height, int bytesPerPixel) {
+    allocSlot(back_, width, height, bytesPerPixel);
+    pending_[back_].clear();
+    stale_[back_] = false;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (i != back_) stale_[i] = true;
+    }
+    return slots_[back_].data;
+}
+
+void FrameExchange::catchUp(int dst, int src) {
+    VncFrame& d = slots_[dst];
+    const VncFrame& s = slots_[src];
+
+    if (stale_[dst] || !d.data || d.width != s.width || d.height != s.height ||
+        d.bytesPerPixel != s.bytesPerPixel) {
+        if (!d.data || d.width != s.width || d.height != s.height || d.bytesPerPixel != s.bytesPerPixel) {
+            allocSlot(dst, s.width, s.height, s.bytesPerPixel);
+            if (!d.data) return;
+        }
+        memcpy(d.data, s.data, s.stride * s.height);
+    } else {
+        DamageRegion region = pending_[dst];
+        region.clip(s.width, s.height);
+        for (const DamageRect& r : region) {
+            size_t offset = r.y * s.stride + static_cast<size_t>(r.x) * s.bytesPerPixel;
+            size_t rowBytes = static_cast<size_t>(r.w) * s.bytesPerPixel;
+            for (int row = 0; row < r.h; row++) {
+                memcpy(d.data + offset, s.data + offset, rowBytes);
+                offset += s.stride;
+            }
+        }
+    }
+
+    d.seq = s.seq;
+    pending_[dst].clear();
+    stale_[dst] = false;
+}
+
+uint8_t* FrameExchange::publish(const DamageRegion& damage) {
+    if (!slots_[back_].data) return nullptr;
+
+    slots_[back_].seq = ++seq_;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (i != back_ && !stale_[i]) pending_[i].add(damage);
+    }
+
+    int published = back_;
+    uint8_t prev = ready_.exchange(static_cast<uint8_t>(back_ | FRESH_BIT), std::memory_order_acq_rel);
+    back_ = prev & INDEX_MASK;
+
+    catchUp(back_, published);
+    return slots_[back_].data;
+}
+
+const VncFrame* FrameExchange::acquire() {
+    // Dekker-style handshake with reset(): both sides use seq_cst
+    consumerActive_.store(true);
+    if (closing_.load()) {
+        consumerActive_.store(false);
+        return nullptr;
+    }
+
+    if (ready_.load(std::memory_order_acquire) & FRESH_BIT) {
+        uint8_t prev = ready_.exchange(static_cast<uint8_t>(front_), std::memory_order_acq_rel);
+        front_ = prev & INDEX_MASK;
+    }
+
+    const VncFrame* frame = &slots_[front_];
+    if (!frame->data || frame->seq == 0) {
+        consumerActive_.store(false);
+        return nullptr;
+    }
+    // Dekker-style again with waitConsumed(): either the waiter sees the new
+    // value or we see the waiter and take the mutex before notifying
+    if (frame->seq > consumed_.load(std::memory_order_relaxed)) {
+        consumed_.store(frame->seq);
+        if (consumedWaiters_.load() > 0) {
+            { std::lock_guard<std::mutex> lock(consumedMutex_); }
+            consumedCv_.notify_all();
+        }
+    }
+    return frame;
+}
+
+bool FrameExchange::waitConsumed(uint64_t seq, int timeoutMs) {
+    if (consumed_.load() >= seq) return true;
+    std::unique_lock<std::mutex> lock(consumedMutex_);
+    consumedWaiters_.fetch_add(1);
+    bool ok = consumedCv_.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                   [&] { return consumed_.load() >= seq; });
+    consumedWaiters_.fetch_sub(1);
+    return ok;
+}
+
+void FrameExchange::release() {
+    consumerActive_.store(false, std::memory_order_release);
+}
+
+void FrameExchange::reset() {
+    closing_.store(true);
+    while (consumerActive_.load()) {
+        std::this_thread::yield();
+    }
+
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        freeSlot(i);
+        pending_[i].clear();
+        stale_[i] = false;
+    }
+    back_ = 0;
+    front_ = 2;
+    ready_.store(1);
+    seq_ = 0;
+    consumed_.store(0);
+
+    closing_.store(false);
+}
@@ -0,0 +1,62 @@
+//
+// Damage Region Header for HiSH
+// Bounded list of disjoint framebuffer rectangles with cost-based merging:
+// two rects merge into their bounding box when that uploads no more pixels
+// than keeping them apart plus RECT_COST_PIXELS. Not thread-safe
+//
+
+#ifndef HISH_DAMAGE_REGION_H
+#define HISH_DAMAGE_REGION_H
+
+#include <cstdint>
+
+struct DamageRect {
+    int x;
+    int y;
+    int w;
+    int h;
+
+    bool empty() const { return w <= 0 || h <= 0; }
+    int64_t area() const { return empty() ? 0 : static_cast<int64_t>(w) * h; }
+    bool contains(const DamageRect& o) const;
+    bool intersects(const DamageRect& o) const;
+    DamageRect intersection(const DamageRect& o) const;
+    DamageRect bounds(const DamageRect& o) const;
+};
+
+class DamageRegion {
+public:
+    // Maximum number of disjoint rectangles kept before forced merging
+    static constexpr int MAX_RECTS = 16;
+    // Fixed cost of one extra upload, expressed in pixels (~one 64x64 block)
+    static constexpr int64_t RECT_COST_PIXELS = 64 * 64;
+
+    DamageRegion() = default;
+
+    void add(const DamageRect& r);
+    void add(int x, int y, int w, int h) { add(DamageRect{x, y, w, h}); }
+    void add(const DamageRegion& other);
+    void clear() { count_ = 0; }
+
+    // Clip all rectangles to [0, width) x [0, height), dropping empty ones
+    void clip(int width, int height);
+
+    bool empty() const { return count_ == 0; }
+    int size() const { return count_; }
+    const DamageRect& operator[](int i) const { return rects_[i]; }
+    const DamageRect* begin() const { return rects_; }
+    const DamageRect* end() const { return rects_ + count_; }
+
+    DamageRect bounds() const;
+    int64_t area() const;
+
+private:
+    DamageRect rects_[MAX_RECTS] = {};
+    int count_ = 0;
+
+    void removeAt(int i);
+    bool overlapsOther(const DamageRect& r, int skip) const;
+    DamageRect takeCheapestPair();
+};
+
+#endif // HISH_DAMAGE_REGION_H
@@ -0,0 +1,77 @@
+//
+// In-process Display Bridge Header for HiSH
+// Reads the in-process QEMU's console surface through the hish display hook
+// (hish_display.h) instead of VNC; the VNC connection stays up for input
+//
+// QEMU's switch callback waits for an in-flight upload (surfaceMutex_); its
+// refresh callback only bumps an atomic, since it runs under the BQL
+//
+
+#ifndef HISH_DISPLAY_BRIDGE_H
+#define HISH_DISPLAY_BRIDGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include "frame_exchange.hpp"
+#include "hish_display.h"
+
+using DisplayResizeCallback = std::function<void(int width, int height)>;
+
+class DisplayBridge {
+public:
+    // Attach to the in-process QEMU display. Returns false if libqemu is not
+    // loaded or does not export the hook (the VNC path is used then)
+    // Called from JS thread
+    static bool attach();
+
+    // Detach from QEMU; no callback runs and the surface is not touched after
+    // this returns. Called from JS thread
+    static void detach();
+
+    static bool isActive() { return active_.load(std::memory_order_acquire); }
+
+    // Symbol exported by the libqemu loaded in this process, nullptr if QEMU
+    // is not loaded or the build lacks it. Safe from any thread
+    static void* findQemuSymbol(const char* name);
+
+    // Surface size changes (runs on the QEMU main loop thread). Set before
+    // attach(); VNC no longer reports desktop resizes while updates are paused
+    static void setResizeCallback(DisplayResizeCallback cb);
+
+    // Current QEMU surface as a frame, nullptr if none (or not active). Must be
+    // paired with releaseFrame(); QEMU cannot switch surfaces until then
+    // Called from render thread
+    static const VncFrame* acquireFrame();
+    static void releaseFrame();
+
+    // Size of the current surface, 0 if none. Safe from any thread
+    static int getFrameWidth() { return frameWidth_.load(std::memory_order_acquire); }
+    static int getFrameHeight() { return frameHeight_.load(std::memory_order_acquire); }
+
+    DisplayBridge() = delete;
+
+private:
+    static const HishDisplayOps ops_;
+    static HishDisplayDetachFn detachFn_;
+    static std::atomic<bool> active_;
+
+    // Guards frame_; held by the render thread from acquireFrame() to releaseFrame()
+    static std::mutex surfaceMutex_;
+    static VncFrame frame_;
+    static std::atomic<uint64_t> seq_;  // completed refreshes, copied into frame_.seq
+    static std::atomic<int> frameWidth_;
+    static std::atomic<int> frameHeight_;
+    static DisplayResizeCallback resizeCallback_;
+
+    static uint64_t statRefreshes_;
+    static uint64_t statUpdates_;
+
+    // QEMU main loop callbacks
+    static void onSurfaceSwitch(void* opaque, void* data, int width, int height, int stride, int format);
+    static void onSurfaceUpdate(void* opaque, int x, int y, int w, int h);
+    static void onRefreshDone(void* opaque);
+};
+
+#endif // HISH_DISPLAY_BRIDGE_H
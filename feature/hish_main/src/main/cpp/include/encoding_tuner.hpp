@@ -0,0 +1,109 @@
+//
+// Encoding Tuner Header for HiSH
+// Picks the VNC encoding list, compression and JPEG quality from measured link
+// and decode costs, for VncClient to re-send with SetEncodings mid-session
+//
+// Local links are pinned to raw. Remote links are re-evaluated every WINDOW_MS:
+// queueing (RTT over the minimum) compresses more, decode-bound windows step
+// down, spare throughput raises JPEG quality; holds and lockouts damp flapping.
+// onUpdate() runs on the poll thread; stats() may be called from any thread.
+//
+
+#ifndef HISH_ENCODING_TUNER_H
+#define HISH_ENCODING_TUNER_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+struct EncodingProfile {
+    const char* name;
+    const char* encodings;      // libvncclient encodingsString, preferred first
+    int compressLevel;
+    bool lossy;                 // JPEG rects, so the tuned quality applies
+};
+
+struct EncodingProfileStats {
+    uint64_t updates;
+    uint64_t pixels;
+    double bytesPerPixel;       // on the wire, remote links only (0 = unknown)
+    double decodeUsPerMpx;      // decode time, socket reads excluded
+};
+
+struct EncodingTunerStats {
+    static constexpr int PROFILE_COUNT = 5;
+
+    bool local;
+    bool tuned;                 // false while pinned: local link, or no TCP_INFO
+    int profile;                // index into profiles
+    int qualityLevel;           // JPEG quality, 0-9
+    uint32_t rttUs;             // 0 = not a TCP link
+    uint32_t minRttUs;
+    double throughputKbps;
+    uint32_t switches;
+    EncodingProfileStats profiles[PROFILE_COUNT];
+};
+
+class EncodingTuner {
+public:
+    static constexpr int PROFILE_COUNT = EncodingTunerStats::PROFILE_COUNT;
+    static const EncodingProfile PROFILES[PROFILE_COUNT];
+
+    // New connection; local links start on raw, remote ones on zrle
+    void reset(bool local);
+
+    const EncodingProfile& profile() const { return PROFILES[profile_]; }
+    int qualityLevel() const { return quality_; }
+
+    // End of each FramebufferUpdate with its decode time (poll thread). Returns
+    // true when the profile or quality changed and the encodings must be sent again
+    bool onUpdate(int sock, uint64_t pixels, uint64_t decodeNs);
+
+    EncodingTunerStats stats() const;
+
+private:
+    friend class EncodingTunerTest;
+
+    static constexpr int WINDOW_MS = 2000;
+    static constexpr int MIN_WINDOW_UPDATES = 5;
+    static constexpr int HOLD_WINDOWS = 2;
+    static constexpr int DOWN_LOCKOUT_WINDOWS = 15;
+    static constexpr double CPU_BOUND_US_PER_MPX = 20000.0;
+    static constexpr uint32_t QUEUE_MIN_EXCESS_US = 5000;
+    static constexpr int MIN_QUALITY = 2;
+    static constexpr int MAX_QUALITY = 8;
+    static constexpr int START_QUALITY = 5;
+    static constexpr int QUALITY_DOWN_STEP = 2;
+    static constexpr double QUALITY_HEADROOM = 0.7;     // of capacityKbps_
+
+    struct LinkSample {
+        uint32_t rttUs;
+        uint32_t minRttUs;
+        uint64_t bytesReceived;
+    };
+
+    static bool sampleLink(int sock, LinkSample& out);
+    int decide(uint32_t rttUs, uint32_t minRttUs, double kbps, double decodeUsPerMpx);
+
+    // Poll thread only
+    bool local_ = false;
+    int profile_ = 0;
+    int maxProfile_ = 0;
+    int quality_ = START_QUALITY;
+    double capacityKbps_ = 0.0;         // best throughput while queueing, 0 = unknown
+    std::chrono::steady_clock::time_point windowStart_;
+    bool haveLink_ = false;
+    LinkSample windowLink_ = {};
+    uint64_t windowUpdates_ = 0;
+    uint64_t windowPixels_ = 0;
+    uint64_t windowNs_ = 0;
+    int holdWindows_ = 0;
+    int downLockout_ = 0;
+    int lastStepDownFrom_ = -1;
+
+    // Published at the end of each window
+    mutable std::mutex statsMutex_;
+    EncodingTunerStats stats_ = {};
+};
+
+#endif // HISH_ENCODING_TUNER_H
@@ -0,0 +1,99 @@
+//
+// Triple-Buffered Framebuffer Exchange Header for HiSH
+//
+// Single producer (poll thread) and single consumer (render thread), one
+// atomic exchange per handoff. A published slot is always a complete update;
+// a slot returning to the producer is caught up by copying the rects damaged
+// since it was last current. Slots are page-aligned mappings that keep their
+// capacity across resizes and are not cleared on reuse.
+//
+
+#ifndef HISH_FRAME_EXCHANGE_H
+#define HISH_FRAME_EXCHANGE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "damage_region.hpp"
+
+struct VncFrame {
+    uint8_t* data;
+    int width;
+    int height;
+    int bytesPerPixel;
+    size_t stride;
+    uint64_t seq;       // publish sequence number, 0 = never published
+};
+
+class FrameExchange {
+public:
+    FrameExchange() = default;
+    ~FrameExchange() { reset(); }
+    FrameExchange(const FrameExchange&) = delete;
+    FrameExchange& operator=(const FrameExchange&) = delete;
+
+    // ---- Producer side (poll thread) ----
+
+    // (Re)allocate the back buffer for a new desktop size, returns its memory
+    uint8_t* resize(int width, int height, int bytesPerPixel);
+
+    // Current back buffer (libvncclient decode target), nullptr before resize()
+    uint8_t* backBuffer() const { return slots_[back_].data; }
+
+    // Publish the back buffer with the damage of the update just decoded.
+    // Returns the new back buffer, already caught up with the published one.
+    uint8_t* publish(const DamageRegion& damage);
+
+    // Sequence number of the last publish() (0 = none since reset)
+    uint64_t published() const { return seq_; }
+    // Published frames the consumer has not acquired yet
+    uint64_t unconsumed() const { return seq_ - consumed_.load(); }
+    // Block until the consumer has acquired frame `seq` or newer, at most
+    // timeoutMs. Returns false on timeout
+    bool waitConsumed(uint64_t seq, int timeoutMs);
+
+    // ---- Consumer side (render thread) ----
+
+    // Latest complete frame, nullptr if nothing was published yet (or reset()
+    // is running). Must be paired with release(); the frame stays valid and
+    // unmodified until then.
+    const VncFrame* acquire();
+    void release();
+
+    // Free all buffers (any thread, producer stopped). Waits for the consumer.
+    void reset();
+
+private:
+    static constexpr int SLOT_COUNT = 3;
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4;
+
+    VncFrame slots_[SLOT_COUNT] = {};
+    size_t capacity_[SLOT_COUNT] = {};  // mapped bytes behind slots_[i].data
+    // Rects each slot is missing relative to the newest published frame
+    DamageRegion pending_[SLOT_COUNT];
+    bool stale_[SLOT_COUNT] = {};       // needs a full copy (size changed)
+
+    int back_ = 0;                      // producer-owned
+    int front_ = 2;                     // consumer-owned
+    std::atomic<uint8_t> ready_{1};     // ready slot index | FRESH_BIT
+    uint64_t seq_ = 0;
+
+    // Newest sequence handed out by acquire(); consumedWaiters_ lets acquire()
+    // skip the mutex unless the producer is waiting
+    std::atomic<uint64_t> consumed_{0};
+    std::atomic<int> consumedWaiters_{0};
+    std::mutex consumedMutex_;
+    std::condition_variable consumedCv_;
+
+    std::atomic<bool> consumerActive_{false};
+    std::atomic<bool> closing_{false};
+
+    void allocSlot(int index, int width, int height, int bytesPerPixel);
+    void freeSlot(int index);
+    void catchUp(int dst, int src);
+};
+
+#endif // HISH_FRAME_EXCHANGE_H
@@ -0,0 +1,66 @@
+//
+// In-process Display Hook ABI for HiSH
+//
+// Shared between the app (display_bridge.cpp) and the hish libqemu build
+// (deps/libqemu/hish-display.c, which copies this header into the QEMU tree).
+// libqemu registers a DisplayChangeListener on the first graphic console and
+// forwards its surface and dirty rects through HishDisplayOps, so the renderer
+// reads QEMU's pixman surface directly instead of going through VNC.
+//
+// All callbacks run on the QEMU main loop thread. The surface passed to
+// surface_switch stays valid until the next surface_switch (or detach)
+// returns, so the app must stop reading it before returning from either.
+//
+// Plain C: keep this header free of C++ constructs.
+//
+
+#ifndef HISH_DISPLAY_H
+#define HISH_DISPLAY_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISH_DISPLAY_ABI_VERSION 1
+
+#define HISH_DISPLAY_ATTACH_SYMBOL "hish_display_attach"
+#define HISH_DISPLAY_DETACH_SYMBOL "hish_display_detach"
+#define HISH_VNC_ADD_CLIENT_SYMBOL "hish_vnc_add_client"
+
+// Pixel layouts of the surface memory
+enum HishDisplayFormat {
+    HISH_DISPLAY_FORMAT_NONE = 0,       // no surface / not representable
+    HISH_DISPLAY_FORMAT_BGRX8888 = 1,   // pixman x8r8g8b8 / a8r8g8b8, little endian
+    HISH_DISPLAY_FORMAT_RGB565 = 2,     // pixman r5g6b5, little endian
+};
+
+typedef struct HishDisplayOps {
+    uint32_t abi_version;               // HISH_DISPLAY_ABI_VERSION
+    uint32_t size;                      // sizeof(HishDisplayOps)
+
+    // New surface (resolution or format change); data == NULL if none
+    void (*surface_switch)(void* opaque, void* data, int width, int height, int stride, int format);
+    // Area of the current surface changed
+    void (*surface_update)(void* opaque, int x, int y, int w, int h);
+    // End of a display refresh that produced at least one surface_update
+    void (*refresh_done)(void* opaque);
+} HishDisplayOps;
+
+// Attach ops (replacing any previous ones). The current surface is replayed
+// through surface_switch from the QEMU main loop. Returns 0 on success.
+typedef int (*HishDisplayAttachFn)(const HishDisplayOps* ops, void* opaque);
+// Detach: no callback runs after this returns. Safe from any thread.
+typedef void (*HishDisplayDetachFn)(void);
+
+// Hand a connected stream socket (e.g. one end of a socketpair) to the VNC
+// server as a new client without authentication, like QMP add_client. QEMU
+// owns fd on success. Returns 0 if queued for the main loop, -1 otherwise.
+typedef int (*HishVncAddClientFn)(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISH_DISPLAY_H
@@ -0,0 +1,78 @@
+//
+// Input Queue Header for HiSH
+// Bounded lock-free multi-producer / single-consumer queue of input events
+//
+// Producers (JS thread, any other thread) never block and never touch the
+// socket; the VNC input writer thread pops events in order and sends them.
+// Each cell carries a sequence number (Vyukov's bounded queue): a producer
+// claims a slot with one CAS on enqueuePos_ and publishes it with a release
+// store of the cell sequence, the consumer needs no atomic RMW at all.
+//
+
+#ifndef HISH_INPUT_QUEUE_H
+#define HISH_INPUT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+struct InputEvent {
+    enum Type : uint8_t {
+        Pointer,
+        Key,
+    };
+    Type type;
+    bool down;          // Key
+    int32_t x;          // Pointer
+    int32_t y;
+    int32_t buttonMask;
+    uint32_t key;       // Key: X11 keysym
+};
+
+class InputQueue {
+public:
+    static constexpr size_t CAPACITY = 256;     // power of two
+
+    InputQueue();
+    InputQueue(const InputQueue&) = delete;
+    InputQueue& operator=(const InputQueue&) = delete;
+
+    // Any thread. Returns false if the queue is full (event dropped)
+    bool push(const InputEvent& ev);
+
+    // Consumer thread only. Returns false if empty
+    bool pop(InputEvent& ev);
+
+private:
+    static constexpr size_t MASK = CAPACITY - 1;
+
+    struct Cell {
+        std::atomic<size_t> seq;
+        InputEvent ev;
+    };
+
+    Cell cells_[CAPACITY];
+    alignas(64) std::atomic<size_t> enqueuePos_{0};
+    alignas(64) size_t dequeuePos_ = 0;
+};
+
+// Writer side pointer coalescing: motion with an unchanged button mask keeps
+// only the latest position, a transition or key flushes it first, so presses
+// and releases are never merged or reordered
+class MotionCoalescer {
+public:
+    // One popped event in; the events to send now (0-2, in order) out
+    int feed(const InputEvent& ev, InputEvent out[2]);
+    // Take the pending motion, false if there is none
+    bool flush(InputEvent& out);
+    bool pending() const { return hasMotion_; }
+    uint64_t coalesced() const { return coalesced_; }
+
+private:
+    int32_t lastMask_ = -1;     // mask last sent; -1 = nothing sent yet
+    bool hasMotion_ = false;    // latest unsent motion is in motion_
+    InputEvent motion_ = {};
+    uint64_t coalesced_ = 0;
+};
+
+#endif // HISH_INPUT_QUEUE_H
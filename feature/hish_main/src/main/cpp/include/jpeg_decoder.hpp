@@ -0,0 +1,79 @@
+//
+// JPEG Decoder Header for HiSH
+// Decodes Tight JPEG rects straight into the framebuffer on worker threads
+//
+// Rects are written out of order: waitRect() before any other write into the
+// same pixels, waitAll() before publishing a frame or reallocating the buffer.
+//
+
+#ifndef HISH_JPEG_DECODER_H
+#define HISH_JPEG_DECODER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JpegDecoder {
+public:
+    JpegDecoder() = default;
+    ~JpegDecoder() { stop(); }
+    JpegDecoder(const JpegDecoder&) = delete;
+    JpegDecoder& operator=(const JpegDecoder&) = delete;
+
+    // Spawn `threads` workers (0 = callers use decodeNow())
+    void start(int threads);
+    // Drop queued rects and join the workers
+    void stop();
+
+    // Queue a w x h JPEG for decoding into fb at (x, y). False if there is no
+    // worker to take it (none started, or stopping): decodeNow() it instead.
+    // Asynchronous failures only show up in failures()
+    bool submit(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                int x, int y, int w, int h, int bytesPerPixel);
+    // decode() on the calling thread, counted in rects()/failures()
+    bool decodeNow(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                   int x, int y, int w, int h, int bytesPerPixel);
+
+    // Block until no queued rect intersects x, y, w, h
+    void waitRect(int x, int y, int w, int h);
+    void waitAll();
+
+    uint64_t rects() const { return statRects_.load(std::memory_order_relaxed); }
+    uint64_t failures() const { return statFailures_.load(std::memory_order_relaxed); }
+
+    // Synchronous decode, false on corrupt data or a size mismatch
+    static bool decode(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                       int x, int y, int w, int h, int bytesPerPixel);
+
+private:
+    static constexpr size_t MAX_QUEUED = 16;
+
+    struct Job {
+        std::vector<uint8_t> data;
+        uint8_t* fb;
+        size_t stride;
+        int x, y, w, h;
+        int bytesPerPixel;
+        bool taken;
+    };
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable workCv_;
+    std::condition_variable doneCv_;
+    bool stopping_ = false;
+    std::list<Job> jobs_;                   // queued and running, oldest first
+    std::atomic<int> pending_{0};           // jobs_.size(), checked without the lock
+    std::atomic<uint64_t> statRects_{0};
+    std::atomic<uint64_t> statFailures_{0};
+
+    void workerLoop();
+    bool intersects(int x, int y, int w, int h) const;
+};
+
+#endif // HISH_JPEG_DECODER_H
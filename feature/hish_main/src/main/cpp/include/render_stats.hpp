@@ -0,0 +1,70 @@
+//
+// Render Statistics Header for HiSH
+// Per-frame renderer counters in a lock-free ring, summarized as percentiles
+//
+// Single writer (render thread) pushes one FrameStats per presented frame;
+// any thread may summarize() concurrently. Each slot carries a sequence
+// number that is odd while being written, readers skip slots that change
+// under them, so neither side ever blocks.
+//
+
+#ifndef HISH_RENDER_STATS_H
+#define HISH_RENDER_STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+struct FrameStats {
+    uint32_t timestampMs;   // steady clock at present (wraps)
+    uint32_t uploadBytes;   // bytes sent to tile textures
+    uint32_t uploadRects;   // texture sub-image uploads
+    uint32_t uploadUs;      // updateTexture() wall time
+    uint32_t gpuUs;         // GPU time of a recent frame, 0 = not measured
+    uint32_t swapUs;        // eglSwapBuffers (with damage) duration
+    uint32_t frameUs;       // whole renderFrameInternal() wall time
+    uint32_t coalesced;     // decoded frames never shown (replaced before upload)
+};
+
+struct StatPercentiles {
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+    uint32_t max;
+};
+
+struct RenderStatsSummary {
+    uint32_t frames;        // frames in the window
+    float fps;              // over the window
+    uint32_t coalescedTotal;
+    bool gpuTiming;         // gpu percentiles are meaningful
+    StatPercentiles uploadBytes;
+    StatPercentiles uploadRects;
+    StatPercentiles uploadUs;
+    StatPercentiles gpuUs;
+    StatPercentiles swapUs;
+    StatPercentiles frameUs;
+};
+
+class RenderStatsRing {
+public:
+    static constexpr int CAPACITY = 256;   // ~4s at 60 fps
+
+    void push(const FrameStats& stats);
+    RenderStatsSummary summarize() const;
+    void clear();
+
+private:
+    static constexpr int WORDS = sizeof(FrameStats) / sizeof(uint32_t);
+
+    struct Slot {
+        std::atomic<uint32_t> seq{0};
+        std::atomic<uint32_t> words[WORDS];
+    };
+
+    Slot slots_[CAPACITY];
+    std::atomic<uint32_t> head_{0};   // total frames pushed (writer-owned)
+
+    bool read(int index, FrameStats& out) const;
+};
+
+#endif // HISH_RENDER_STATS_H
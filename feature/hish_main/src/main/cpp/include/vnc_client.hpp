@@ -1,6 +1,8 @@
 //
 // VNC Client Header for HiSH
-// Wraps libvncclient with RGB565 pixel format and thread-safe socket access
+// Wraps libvncclient with a negotiable pixel format and thread-safe socket access
+// Decoded frames go to the renderer through a lock-free triple buffer; input
+// goes to the server from a writer thread, never waiting for the decoder
 //
 
 #ifndef HISH_VNC_CLIENT_H
@@ -11,7 +13,14 @@
 #include <functional>
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <cstring>
+#include <string>
+#include <thread>
+#include "encoding_tuner.hpp"
+#include "frame_exchange.hpp"
+#include "input_queue.hpp"
+#include "jpeg_decoder.hpp"
 
 struct VncFrameInfo {
     int32_t fbWidth;
@@ -22,31 +31,88 @@ struct VncFrameInfo {
     int32_t h;
 };
 
+// Wire pixel format requested from the server. BGRX8888 matches QEMU's native
+// x8r8g8b8 surface (no server-side conversion, 2x bandwidth); RGB565 halves
+// the bytes on the wire. Auto picks BGRX8888 for loopback, RGB565 otherwise.
+enum class VncPixelFormat {
+    Auto = 0,
+    Rgb565 = 1,
+    Bgrx8888 = 2,
+};
+
 using VncResizeCallback = std::function<void(int width, int height)>;
 using VncFrameCallback = std::function<void(const VncFrameInfo& info)>;
 
 class VncClient {
 public:
-    static bool connect(const char* address, int port, const char* passwd);
+    static bool connect(const char* address, int port, const char* passwd,
+                        VncPixelFormat format, const std::atomic<bool>& cancel);
     static void disconnect();
     static bool isConnected();
 
+    // connect() once the server answers (the in-process hook for loopback, else
+    // a TCP probe): until then (QEMU still booting) it retries with exponential
+    // backoff for up to timeoutMs. Blocks, so call it from a worker thread;
+    // gives up early once `cancel` is set
+    static bool connectWhenReady(const char* address, int port, const char* passwd,
+                                 VncPixelFormat format, int timeoutMs, const std::atomic<bool>& cancel);
+    // After the connection broke: drop the socket but keep the last frame (the
+    // renderer goes on showing it), then handshake again with the same server,
+    // retrying with backoff for up to timeoutMs. Resumes with the single full
+    // update request of the handshake. Poll thread
+    static bool reconnect(int timeoutMs, const std::atomic<bool>& cancel);
+    // Read server messages until the first complete update has been decoded.
+    // Worker thread, before the poll thread is started
+    static bool waitFirstUpdate(int timeoutMs, const std::atomic<bool>& cancel);
+    // Make a handshake in progress fail now instead of blocking on a silent
+    // server: shuts its socket down. Call after setting the `cancel` given to
+    // connectWhenReady/reconnect. Safe from any thread
+    static void abortConnect();
+
+    // Queue input for the writer thread; never blocks. Safe from any thread
     static void sendMouseEvent(int x, int y, int buttonMask);
     static void sendKeyEvent(uint32_t key, bool down);
 
+    // Ask the server to resize the guest display (debounced). Ignored by
+    // servers without ExtendedDesktopSize. Safe from any thread
+    static void requestDesktopSize(int width, int height);
+
+    // Updates are requested only while all three are true; resuming asks for
+    // one full update. Safe from any thread, applied by applyUpdateState()
+    static void setUpdatesEnabled(bool enabled);
+    static void setPageVisible(bool visible);
+    static void setSurfaceAttached(bool attached);
+    // Poll thread, under the socket mutex, before each wait for messages.
+    // Also sends an update request held back for the renderer once it is due
+    static void applyUpdateState();
+
+    // Frames the decoder may run ahead of the renderer, including the one
+    // being decoded (0 = no flow control). Safe from any thread
+    static void setFrameLead(int frames);
+    // Poll thread, without the socket mutex: while an update request is held
+    // back, sleep until the renderer catches up (bounded by FLOW_MAX_DEFER_MS)
+    static void waitForRenderer();
+
+    static bool isLoopbackAddress(const char* address);
+
     static void setResizeCallback(VncResizeCallback cb);
     static void setFrameCallback(VncFrameCallback cb);
 
-    static uint8_t* getFrameBuffer();
+    // Latest complete frame for the render thread (no mutex). Returns nullptr
+    // if nothing was decoded yet; otherwise call releaseFrame() when done.
+    static const VncFrame* acquireFrame() { return frames_.acquire(); }
+    static void releaseFrame() { frames_.release(); }
+
+    // Size of the desktop currently being decoded (may be ahead of acquireFrame)
     static int getFrameWidth();
     static int getFrameHeight();
     static rfbClient* getClient();
 
-    // Framebuffer mutex: protects frameBuffer_/fbWidth_/fbHeight_ across threads.
-    // onResize (poll thread) writes, updateTexture (render thread) reads.
-    static std::mutex& getFbMutex() { return fbMutex_; }
+    // Current encoding profile and link measurements. Safe from any thread
+    static EncodingTunerStats getEncodingStats() { return tuner_.stats(); }
 
-    // Socket mutex: libvncclient is NOT thread-safe, all socket I/O must be serialized
+    // Socket mutex: libvncclient is NOT thread-safe; serializes the read side
+    // (WaitForMessage/HandleRFBServerMessage) and client state changes
     static std::mutex& getSocketMutex() { return socketMutex_; }
 
     VncClient() = delete;
@@ -56,20 +122,129 @@ private:
     static std::atomic<bool> connected_;
     static char password_[256];
 
-    static uint8_t* frameBuffer_;
-    static int fbWidth_;
-    static int fbHeight_;
-    static std::mutex fbMutex_;
+    // Poll thread decodes into frames_' back buffer; damage of the update in
+    // progress is collected in updateDamage_ and published as one frame
+    static FrameExchange frames_;
+    static DamageRegion updateDamage_;
+    static std::atomic<int> fbWidth_;
+    static std::atomic<int> fbHeight_;
 
     static VncResizeCallback resizeCallback_;
     static VncFrameCallback frameCallback_;
     static std::mutex socketMutex_;
 
+    // Input path: producers push and signal inputEventFd_ (kept for the
+    // process), the writer thread drains the queue; inputProducers_ lets
+    // stopWriter() wait out late pushes before emptying it
+    static InputQueue inputQueue_;
+    static const int inputEventFd_;
+    static std::atomic<int> inputProducers_;
+    static std::thread writerThread_;
+    static std::atomic<bool> writerRunning_;
+    static std::mutex writeMutex_;          // app-initiated write sequences
+    static std::atomic<uint64_t> statInputDropped_;
+    static uint64_t statMotionCoalesced_;
+    static constexpr int MOTION_INTERVAL_MS = 8;    // ~120 Hz pointer motion
+
+    // Pixel format in use (never Auto once connected) and per-mode update
+    // statistics: time from the first rect of an update to its end covers
+    // receiving + decoding, which is where server-side conversion shows up
+    static VncPixelFormat pixelFormat_;
+    static std::chrono::steady_clock::time_point updateStart_;
+    static bool updateInProgress_;
+    static uint64_t updateReadNs_;      // socket read time at updateStart_
+    static uint64_t statUpdates_;
+    static uint64_t statPixels_;
+    static uint64_t statUpdateNs_;
+    static uint64_t updatePixels_;
+    static EncodingTuner tuner_;
+    static constexpr int MAX_JPEG_WORKERS = 2;
+    static JpegDecoder jpeg_;
+
+    // Loopback connects try a socketpair into the in-process QEMU first
+    static constexpr int LOCAL_CONNECT_TIMEOUT_MS = 3000;
+    static constexpr int CONNECT_RETRY_MIN_MS = 100;
+    static constexpr int CONNECT_RETRY_MAX_MS = 2000;
+    static constexpr int CONNECT_PROBE_TIMEOUT_MS = 1000;
+    static constexpr int CONNECT_TIMEOUT_MS = 5000;
+    static std::string address_;        // of the last connect(), for reconnect()
+    static int port_;
+    static std::mutex handshakeMutex_;  // guards handshakeSock_
+    static int handshakeSock_;          // socket of the handshake in progress
+
+    // ContinuousUpdates/Fence state; poll thread or under socketMutex_
+    static constexpr int FENCE_WINDOW = 2;     // unanswered fences before CU pauses
+    static bool updatesEnabled_;        // as last applied to the client
+    static std::atomic<bool> updatesRequested_;
+    static std::atomic<bool> pageVisible_;
+    static std::atomic<bool> surfaceAttached_;
+    static bool cuSupported_;           // server sent EndOfContinuousUpdates
+    static bool cuActive_;              // last EnableContinuousUpdates sent
+    static bool fenceSupported_;        // server sent a Fence request
+    static int fencesInFlight_;
+    static uint64_t statFenceThrottled_;
+
+    // Request/response flow control; poll thread or under socketMutex_.
+    // requestHeld_ mirrors the cleared rfbFramebufferUpdateRequest bit,
+    // requestDeferred_ means libvncclient skipped a request we still owe.
+    // Nothing may consume frames (no surface yet, headless), hence the timeout
+    static constexpr int FRAME_LEAD_DEFAULT = 2;
+    static constexpr int FLOW_MAX_DEFER_MS = 100;
+    static std::atomic<int> frameLead_;     // unrendered frames before a request is held
+    static bool requestHeld_;
+    static bool requestDeferred_;
+    static std::chrono::steady_clock::time_point deferredSince_;
+    static uint64_t statRequestsDeferred_;
+    static uint64_t statDeferTimeouts_;
+
+    // ExtendedDesktopSize: support and screen layout come from the poll
+    // thread, the wanted size from requestDesktopSize (desktopSizeMutex_)
+    static constexpr int DESKTOP_SIZE_DEBOUNCE_MS = 500;   // rotation sends several sizes
+    static std::atomic<bool> extDesktopSizeSupported_;
+    static std::atomic<uint32_t> screenId_;
+    static std::atomic<uint32_t> screenFlags_;
+    static std::mutex desktopSizeMutex_;
+    static bool desktopSizePending_;
+    static int wantedWidth_;
+    static int wantedHeight_;
+    static std::chrono::steady_clock::time_point desktopSizeDue_;
+
     // libvncclient callbacks
     static rfbBool onResize(rfbClient* cl);
     static void onUpdate(rfbClient* cl, int x, int y, int w, int h);
+    static void onFinishedUpdate(rfbClient* cl);
+    static void onFillRect(rfbClient* cl, int x, int y, int w, int h, uint32_t colour);
+    static void onBitmap(rfbClient* cl, const uint8_t* buffer, int x, int y, int w, int h);
+    static void onCopyRect(rfbClient* cl, int srcX, int srcY, int w, int h, int dstX, int dstY);
+    static rfbBool onJpeg(rfbClient* cl, const uint8_t* buffer, int length, int x, int y, int w, int h);
     static char* getPassword(rfbClient* cl);
-    static bool checkConnection();
+    static rfbBool onServerMessage(rfbClient* cl, rfbServerToClientMsg* msg);
+    static rfbBool onServerEncoding(rfbClient* cl, rfbFramebufferUpdateRectHeader* rect);
+    static int desktopSizeDelayMs();
+    static bool sendDesktopSize();
+    static void updateContinuousUpdates();
+    static void updateRequestHold();
+    static void releaseDeferredRequest();
+    static void applyEncodingProfile();
+    static bool sendEnableContinuousUpdates(bool enable);
+    static bool sendFence(uint32_t flags, const char* payload, uint8_t length);
+    static bool createClient(const char* address, int port);
+    static int openLocalSocket(const std::atomic<bool>& cancel);
+    static int openTcpSocket(const char* address, int port, int timeoutMs,
+                             const std::atomic<bool>& cancel);
+    static bool backoff(int& delayMs, std::chrono::steady_clock::time_point deadline,
+                        const std::atomic<bool>& cancel);
+    static void setTarget(const char* address, int port, const char* passwd, VncPixelFormat format);
+    static bool openClient(int localSock, const std::atomic<bool>& cancel);
+    static bool openWhenReady(int timeoutMs, bool retryHandshake, const std::atomic<bool>& cancel);
+    static void closeClient();
+    static bool initConnection(int sock, const std::atomic<bool>& cancel);
+    static void queueInput(const InputEvent& ev);
+    static void startWriter();
+    static void stopWriter();
+    static void writerLoop();
+    static VncPixelFormat resolvePixelFormat(VncPixelFormat format, const char* address);
+    static void logUpdateStats();
 };
 
 #endif // HISH_VNC_CLIENT_H
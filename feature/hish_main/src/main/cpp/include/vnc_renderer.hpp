@@ -5,7 +5,13 @@
 //   - Poll thread: calls markDirty() only (no GL/EGL calls)
 //   - Render thread: owns EGL context, runs renderLoop() with condition variable wakeup
 //   - JS thread: calls init/shutdown/resize (no GL calls except during init)
-//     resize() and markDirty() wake the render thread via condition variable
+//     resize() and markDirty() request a display vsync; the vsync callback wakes
+//     the render thread, so all damage within one frame interval is coalesced
+//     and the thread sleeps without timeouts while idle
+//   - Headless mode (initHeadless/detachSurface): offscreen context without a
+//     window; nothing is presented, the render thread only serves thumbnail
+//     captures. The context, program and tile textures survive until a new
+//     window is attached by init(surfaceId), which then only re-uploads damage
 //
 
 #ifndef HISH_VNC_RENDERER_H
@@ -13,23 +19,56 @@
 
 #include <cstdint>
 #include <mutex>
+#include <string>
 #include <atomic>
 #include <thread>
 #include <condition_variable>
+#include <vector>
 #include <EGL/egl.h>
+#include <EGL/eglext.h>
 #include <GLES3/gl32.h>
+#include <GLES2/gl2ext.h>
 #include <native_window/external_window.h>
+#include <native_vsync/native_vsync.h>
+#include "damage_region.hpp"
+#include "frame_exchange.hpp"
+#include "render_stats.hpp"
+
+struct ScreenMapping;   // framebuffer -> render target mapping (vnc_renderer.cpp)
 
 class VncRenderer {
 public:
-    // Initialize EGL + GL with XComponent surface ID, then start render thread
+    // Initialize EGL + GL with XComponent surface ID, then start render thread.
+    // Reuses a live (detached or headless) context when its config allows it.
     // Called from JS thread
     static bool init(int64_t surfaceId);
 
+    // Window is going away: drop the EGL window surface but keep the context
+    // and GL resources on an offscreen surface (headless) for the next init()
+    // Called from JS thread
+    static void detachSurface();
+
+    // Directory for the linked program binary cache (ES3 only); empty disables
+    // it. Takes effect on the next context creation. Called from JS thread
+    static void setProgramCacheDir(const char* dir);
+
+    // Initialize without a window: pbuffer (or any offscreen) EGL surface, no
+    // vsync, no presentation. Used for thumbnails and offscreen benchmarks.
+    // A later init(surfaceId) takes it over. Called from any non-render thread
+    static bool initHeadless();
+    static bool isHeadless() { return headless_.load(std::memory_order_acquire); }
+
     // Stop render thread and release all resources
     // Called from JS thread
     static void shutdown();
 
+    // Render the current framebuffer downscaled to fit maxWidth x maxHeight
+    // into rgba (RGBA8888, top row first). Runs on the render thread, starting
+    // the headless renderer if there is no surface. Blocks: never call from
+    // the JS thread
+    static bool captureThumbnail(int maxWidth, int maxHeight, std::vector<uint8_t>& rgba,
+                                 int& width, int& height);
+
     // Handle surface resize — wakes render thread for full re-upload
     // Safe from any thread
     static void resize(int width, int height);
@@ -38,6 +77,19 @@ public:
     // Thread-safe, no GL calls — called from poll thread
     static void markDirty(int x, int y, int w, int h);
 
+    // Zoom/pan view: zoom >= 1 magnifies the letterboxed desktop, (panX, panY)
+    // is the framebuffer pixel shown at the top-left of the letterbox area.
+    // Pan is clamped to the desktop. Safe from any thread
+    static void setViewTransform(float zoom, float panX, float panY);
+
+    // Percentiles over the last RenderStatsRing::CAPACITY presented frames
+    // Safe from any thread (lock-free)
+    static RenderStatsSummary getStats();
+
+    // Cap presented frames per second (e.g. 30/60/120); 0 = every display vsync
+    // Safe from any thread
+    static void setFrameRateCap(int fps);
+
     VncRenderer() = delete;
 
 private:
@@ -52,12 +104,83 @@ private:
     static GLuint shaderProgram_;
     static GLuint vao_;
     static GLuint vbo_;
-    static GLuint textureId_;
+    static bool isGLES3_;
+    static std::string programCacheDir_;
+    static bool frameFromBridge_;           // source of the frame acquired by updateTexture
+
+    // The framebuffer is split into tiles of up to TILE_SIZE pixels, one texture
+    // each, so desktops larger than GL_MAX_TEXTURE_SIZE still render. Every
+    // texture also stores a 1px border from its neighbours so linear filtering
+    // is seamless across tile edges. Damage is queued per tile and uploaded
+    // only while the tile is visible; invisible tiles are not drawn either.
+    static constexpr int TILE_SIZE = 512;
+    struct Tile {
+        GLuint tex;
+        DamageRect content;     // framebuffer area drawn from this tile
+        DamageRect texRect;     // framebuffer area stored in the texture
+        DamageRegion pending;   // texRect damage not uploaded yet
+    };
+    static std::vector<Tile> tiles_;
+    static int tileSize_;
+
+    // Texture format follows the frame: 2 bytes/pixel = RGB565, 4 = BGRX8888
+    // uploaded as RGBA bytes and swizzled back in the fragment shader
+    static int texBytesPerPixel_;
+    static GLenum texFormat_;
+    static GLenum texType_;
+
+    // One upload batch entry: framebuffer rect r goes into tile texture at
+    // (r.x - texRect.x, r.y - texRect.y)
+    struct TileUpload {
+        const Tile* tile;
+        DamageRect r;
+    };
+    static std::vector<TileUpload> uploads_;
+    static std::vector<uint8_t> uploadScratch_;     // GLES2 row packing
+
+    // Pixel unpack buffer ring (GLES3 only): dirty rects are staged into a
+    // mapped PBO under the framebuffer lock, the texture update then reads
+    // from the PBO so the copy to GPU memory is asynchronous. A fence per
+    // PBO tells us when the GPU has finished with it.
+    static constexpr int PBO_COUNT = 3;
+    static GLuint pbos_[PBO_COUNT];
+    static GLsync pboFences_[PBO_COUNT];
+    static size_t pboCapacity_[PBO_COUNT];
+    static int pboIndex_;
 
     // Shader uniform/attribute locations
     static GLint posLoc_;
-    static GLint texCoordLoc_;
     static GLint texLoc_;
+    static GLint dstRectLoc_;
+    static GLint srcRectLoc_;
+    static GLint swizzleLoc_;
+
+    // Upload cost (render thread), logged per pixel format on shutdown
+    static uint64_t statUploadBatches_;
+    static uint64_t statUploadPixels_;
+    static uint64_t statUploadNs_;
+
+    // Per-frame counters (render thread) feeding the lock-free stats ring
+    static RenderStatsRing stats_;
+    static uint32_t frameUploadBytes_;
+    static uint32_t frameUploadRects_;
+    static uint32_t frameCoalesced_;
+    static uint64_t lastFrameSeq_;
+
+    // GPU timing via GL_EXT_disjoint_timer_query. Results arrive a few frames
+    // late, so each frame records the most recent completed measurement.
+    static constexpr int GPU_QUERY_COUNT = 4;
+    static PFNGLGENQUERIESEXTPROC genQueries_;
+    static PFNGLDELETEQUERIESEXTPROC deleteQueries_;
+    static PFNGLBEGINQUERYEXTPROC beginQuery_;
+    static PFNGLENDQUERYEXTPROC endQuery_;
+    static PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv_;
+    static PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v_;
+    static GLuint gpuQueries_[GPU_QUERY_COUNT];
+    static bool gpuQueryPending_[GPU_QUERY_COUNT];
+    static int gpuQueryIndex_;
+    static bool gpuQueryActive_;
+    static uint32_t lastGpuUs_;
 
     // VNC framebuffer dimensions (set by updateTexture on realloc)
     static int vncWidth_;
@@ -69,9 +192,18 @@ private:
 
     // Dirty region tracking (written by any thread via markDirty, read by render thread)
     static std::atomic<bool> dirty_;
-    static int dirtyX_, dirtyY_, dirtyW_, dirtyH_;
+    static DamageRegion dirtyRegion_;
     static std::mutex dirtyMutex_;
 
+    // View transform (guarded by dirtyMutex_); a change repaints the whole surface
+    struct ViewTransform {
+        float zoom;
+        float panX;
+        float panY;
+    };
+    static ViewTransform view_;
+    static bool viewChanged_;
+
     // Render thread state
     static std::thread renderThread_;
     static std::atomic<bool> renderRunning_;
@@ -79,17 +211,88 @@ private:
     static std::condition_variable renderWakeCv_;
     static std::atomic<bool> surfaceResized_;
 
+    // VSync pacing, one outstanding request (timed pacing without a source).
+    // The handle lives for the process: markDirty() callers hold no lifecycle
+    // lock. vsyncPaced_ only while a window render thread runs
+    static std::atomic<OH_NativeVSync*> vsync_;
+    static std::atomic<bool> vsyncPaced_;
+    static std::atomic<bool> vsyncRequested_;
+    static std::atomic<bool> vsyncTick_;
+    static std::atomic<int> frameRateCap_;
+    static long long vsyncPeriodNs_;
+
+    // Partial presentation: swap-with-damage tells the compositor what changed,
+    // partial_update + buffer age let us redraw only damaged screen areas.
+    // Screen damage of recent frames (top-left origin) is kept so a back buffer
+    // that is N frames old can be repaired. Missing extensions = full swaps.
+    static constexpr int DAMAGE_HISTORY = 3;
+    static PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC swapWithDamage_;
+    static PFNEGLSETDAMAGEREGIONKHRPROC setDamageRegion_;
+    static bool hasBufferAge_;
+    static DamageRegion screenHistory_[DAMAGE_HISTORY];
+    static int historyCount_;
+
     // Init state (set during init, checked by render thread)
     static std::atomic<bool> initialized_;
+    static std::atomic<bool> headless_;
+    static std::mutex lifecycleMutex_;      // serializes init/initHeadless/shutdown
+
+    // Thumbnail capture: one request at a time is handed to the render thread
+    // (guarded by renderWakeMutex_), which renders into an offscreen FBO
+    struct CaptureRequest {
+        int maxWidth;
+        int maxHeight;
+        std::vector<uint8_t>* rgba;
+        int width;
+        int height;
+        bool ok;
+        bool done;
+    };
+    static CaptureRequest* captureRequest_;
+    static std::condition_variable captureDoneCv_;
+    static GLuint captureFbo_;
+    static GLuint captureTex_;
+    static int captureWidth_;
+    static int captureHeight_;
 
     // Internal methods
     static bool initEGL(int64_t surfaceId);
+    static bool initEGLHeadless();
+    static bool createOffscreenSurface();
+    static bool attachWindow(int64_t surfaceId);
+    static void releaseSurface();
+    static void stopRenderThread();
+    static bool initResources();
+    static bool initHeadlessLocked();
+    static void shutdownLocked();
+    static void serviceCapture(CaptureRequest& req);
+    static void finishCapture(bool serviced);
     static bool initGL();
     static bool createShaders();
+    static const VncFrame* acquireFrame();
+    static void releaseFrame();
+    static bool loadProgramBinary(GLuint program, uint64_t key);
+    static void saveProgramBinary(GLuint program, uint64_t key);
     static void cleanupGL();
-    static void updateTexture(int x, int y, int w, int h, bool forceFull = false);
+    static void initPartialPresent();
+    static void initGpuTimer();
+    static void beginGpuTimer();
+    static void endGpuTimer();
+    static void collectGpuTimers();
+    static void rebuildTiles(int width, int height, int bytesPerPixel);
+    static void deleteTiles();
+    static bool updateTexture(const DamageRegion& region, bool forceFull, const ViewTransform& view,
+                              bool allTiles = false);
+    static bool uploadViaPbo(const VncFrame& frame);
+    static void uploadDirect(const VncFrame& frame);
+    static void requestFrame();         // Ask for the next vsync (any thread)
+    static void wakeRenderThread();
+    static void onVsync(long long timestamp, void* data);
     static void renderLoop();           // Render thread entry point
     static void renderFrameInternal();  // Single frame render (called on render thread)
+    static void drawTiles(const ScreenMapping& m, const DamageRect& screenClip,
+                          int targetWidth, int targetHeight);
+    static void pushScreenDamage(const DamageRegion& damage);
 };
 
 #endif // HISH_VNC_RENDERER_H
@@ -0,0 +1,75 @@
+//
+// Input Queue Implementation for HiSH
+//
+
+#include "include/input_queue.hpp"
+
+InputQueue::InputQueue() {
+    for (size_t i = 0; i < CAPACITY; i++) {
+        cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool InputQueue::push(const InputEvent& ev) {
+    Cell* cell;
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    for (;;) {
+        cell = &cells_[pos & MASK];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            // Slot free for this lap: claim it
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // Consumer has not freed it yet: full
+            return false;
+        } else {
+            // Another producer claimed it first
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+    cell->ev = ev;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool InputQueue::pop(InputEvent& ev) {
+    Cell& cell = cells_[dequeuePos_ & MASK];
+    size_t seq = cell.seq.load(std::memory_order_acquire);
+    if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(dequeuePos_ + 1) < 0) {
+        return false;
+    }
+    ev = cell.ev;
+    // Free the slot for the producer one lap ahead
+    cell.seq.store(dequeuePos_ + CAPACITY, std::memory_order_release);
+    dequeuePos_++;
+    return true;
+}
+
+int MotionCoalescer::feed(const InputEvent& ev, InputEvent out[2]) {
+    if (ev.type == InputEvent::Pointer && ev.buttonMask == lastMask_) {
+        // Pure motion: only the latest position matters
+        if (hasMotion_) coalesced_++;
+        motion_ = ev;
+        hasMotion_ = true;
+        return 0;
+    }
+    // Transition or key: pending motion goes first to keep order
+    int n = 0;
+    if (hasMotion_) {
+        out[n++] = motion_;
+        hasMotion_ = false;
+    }
+    if (ev.type == InputEvent::Pointer) {
+        lastMask_ = ev.buttonMask;
+    }
+    out[n++] = ev;
+    return n;
+}
+
+bool MotionCoalescer::flush(InputEvent& out) {
+    if (!hasMotion_) return false;
+    out = motion_;
+    hasMotion_ = false;
+    return true;
+}
@@ -0,0 +1,165 @@
+//
+// JPEG Decoder Implementation for HiSH
+//
+
+#include "include/jpeg_decoder.hpp"
+
+#ifdef LIBVNCSERVER_HAVE_LIBJPEG
+#include <csetjmp>
+#include <cstdio>
+#include <jpeglib.h>
+
+// libjpeg reports errors through error_exit, which must not return
+struct JpegErrorManager {
+    jpeg_error_mgr pub;
+    jmp_buf jump;
+};
+
+static void onJpegError(j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+static void onJpegMessage(j_common_ptr) {
+    // Corrupt-data warnings would flood the log on a bad link
+}
+
+bool JpegDecoder::decode(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                         int x, int y, int w, int h, int bytesPerPixel) {
+    jpeg_decompress_struct cinfo;
+    JpegErrorManager err;
+    cinfo.err = jpeg_std_error(&err.pub);
+    err.pub.error_exit = onJpegError;
+    err.pub.output_message = onJpegMessage;
+    if (setjmp(err.jump)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, data, static_cast<unsigned long>(length));
+    jpeg_read_header(&cinfo, TRUE);
+    if (cinfo.image_width != static_cast<JDIMENSION>(w) || cinfo.image_height != static_cast<JDIMENSION>(h)) {
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    // Same layouts as VncClient's pixel formats: x8r8g8b8 LE and r5g6b5 LE
+    cinfo.out_color_space = bytesPerPixel == 4 ? JCS_EXT_BGRX : JCS_RGB565;
+    cinfo.dither_mode = JDITHER_NONE;
+    jpeg_start_decompress(&cinfo);
+
+    uint8_t* origin = fb + y * stride + static_cast<size_t>(x) * bytesPerPixel;
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW rows[4];
+        JDIMENSION count = 0;
+        for (; count < 4 && cinfo.output_scanline + count < cinfo.output_height; count++) {
+            rows[count] = origin + (cinfo.output_scanline + count) * stride;
+        }
+        jpeg_read_scanlines(&cinfo, rows, count);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+#else
+// libvncclient is built without Tight, GotJpeg is never called
+bool JpegDecoder::decode(const uint8_t*, size_t, uint8_t*, size_t, int, int, int, int, int) {
+    return false;
+}
+#endif
+
+void JpegDecoder::start(int threads) {
+    stop();
+    stopping_ = false;
+    for (int i = 0; i < threads; i++) {
+        threads_.emplace_back(&JpegDecoder::workerLoop, this);
+    }
+}
+
+void JpegDecoder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        // Running jobs finish; the rest target a framebuffer about to go away
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            it = it->taken ? std::next(it) : jobs_.erase(it);
+        }
+        pending_.store(static_cast<int>(jobs_.size()));
+    }
+    workCv_.notify_all();
+    doneCv_.notify_all();
+    for (std::thread& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    threads_.clear();
+}
+
+bool JpegDecoder::intersects(int x, int y, int w, int h) const {
+    for (const Job& job : jobs_) {
+        if (x < job.x + job.w && job.x < x + w && y < job.y + job.h && job.y < y + h) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool JpegDecoder::submit(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                         int x, int y, int w, int h, int bytesPerPixel) {
+    if (threads_.empty()) return false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Overlapping rects land in stream order; a full queue applies backpressure
+    doneCv_.wait(lock, [&] {
+        return stopping_ || (jobs_.size() < MAX_QUEUED && !intersects(x, y, w, h));
+    });
+    if (stopping_) return false;
+    statRects_.fetch_add(1, std::memory_order_relaxed);
+    jobs_.push_back({std::vector<uint8_t>(data, data + length), fb, stride, x, y, w, h, bytesPerPixel, false});
+    pending_.store(static_cast<int>(jobs_.size()));
+    lock.unlock();
+    workCv_.notify_one();
+    return true;
+}
+
+bool JpegDecoder::decodeNow(const uint8_t* data, size_t length, uint8_t* fb, size_t stride,
+                            int x, int y, int w, int h, int bytesPerPixel) {
+    statRects_.fetch_add(1, std::memory_order_relaxed);
+    bool ok = decode(data, length, fb, stride, x, y, w, h, bytesPerPixel);
+    if (!ok) statFailures_.fetch_add(1, std::memory_order_relaxed);
+    return ok;
+}
+
+void JpegDecoder::waitRect(int x, int y, int w, int h) {
+    if (pending_.load() == 0) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [&] { return !intersects(x, y, w, h); });
+}
+
+void JpegDecoder::waitAll() {
+    if (pending_.load() == 0) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [&] { return jobs_.empty(); });
+}
+
+void JpegDecoder::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        auto job = jobs_.end();
+        workCv_.wait(lock, [&] {
+            if (stopping_) return true;
+            for (job = jobs_.begin(); job != jobs_.end() && job->taken; ++job) {}
+            return job != jobs_.end();
+        });
+        if (stopping_) return;
+        job->taken = true;
+        lock.unlock();
+
+        bool ok = decode(job->data.data(), job->data.size(), job->fb, job->stride,
+                         job->x, job->y, job->w, job->h, job->bytesPerPixel);
+        if (!ok) statFailures_.fetch_add(1, std::memory_order_relaxed);
+
+        lock.lock();
+        jobs_.erase(job);
+        pending_.store(static_cast<int>(jobs_.size()));
+        doneCv_.notify_all();
+    }
+}
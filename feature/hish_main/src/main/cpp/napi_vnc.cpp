@@ -5,28 +5,41 @@
 //   - Poll thread: VNC protocol only (WaitForMessage + HandleRFBServerMessage)
 //   - On frame update: markDirty() wakes render thread directly (no TSFN needed)
 //   - On resize: VncRenderer::resize() wakes render thread + TSFN notify(status=1) for JS UI
-//   - On disconnect: TSFN notify(status=-1) for JS UI
+//   - On connection loss: the poll thread reconnects itself with backoff while
+//     the last frame stays on screen, notify(status=2) then notify(status=3,
+//     reconnectMs); notify(status=-1) only once it gives up
 //   - Render thread: owns EGL context, renders on its own thread (never blocks JS)
+//   - Connect: vncInit runs retry + handshake + first update on an async work
+//     thread and resolves its promise on the JS thread
 //
 // Thread safety:
 //   - libvncclient socket I/O is NOT thread-safe: poll cycle protected by socketMutex_
-//   - sendMouseEvent/sendKeyEvent use socketMutex_ to avoid blocking poll thread
-//   - Render thread only reads VNC framebuffer (no socket I/O)
+//   - sendMouseEvent/sendKeyEvent only push to VncClient's lock-free input queue;
+//     its writer thread sends them without waiting for the poll cycle
+//   - Batched input: JS fills an ArrayBuffer ring and calls vncFlushInput once
+//     per gesture callback instead of one vncMouseEvent per sample
+//   - Render thread only reads VNC framebuffer (no socket I/O), taking the latest
+//     complete frame from VncClient's triple buffer without any mutex
 //
 // Protocol notes:
 //   - Do NOT send SendFramebufferUpdateRequest: rfbInitConnection already sends one
 //   - Do NOT send SendIncrementalFramebufferUpdateRequest: HandleRFBServerMessage
 //     sends one internally after each FramebufferUpdate (rfbclient.c:2564)
+//     (VncClient holds that one back while the renderer is behind and sends
+//     it itself later, never both)
 //   - Duplicate requests cause QEMU to produce extra responses that desync the stream
+//   - With ContinuousUpdates negotiated (see VncClient) no requests are sent at all
 //
 
 #include "napi/native_api.h"
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <vector>
 
 #include "hilog/log.h"
 #undef LOG_DOMAIN
@@ -36,12 +49,28 @@
 
 #include "include/vnc_client.hpp"
 #include "include/vnc_renderer.hpp"
+#include "include/display_bridge.hpp"
 #include "include/utils.hpp"
 
 // ---- Poll Thread State ----
 static std::atomic<bool> g_pollRunning(false);
 static std::thread g_pollThread;
 static std::mutex g_pollMutex;  // protects thread creation/joining
+static std::atomic<bool> g_pollStopping(false);    // !g_pollRunning, cancels a reconnect
+static constexpr int RECONNECT_TIMEOUT_MS = 30000;
+
+// ---- Input ring shared with JS (see vncSetInputRing) ----
+// Int32 words: [0] write index (JS), [1] read index (native), [2] capacity in
+// entries (power of two), [3] reserved; then `capacity` entries of 4 words:
+//   {INPUT_RING_POINTER, x, y, buttonMask} or {INPUT_RING_KEY, ohKeyCode, down, 0}
+// Indices run freely and wrap at 2^32. Only touched on the JS thread.
+static constexpr uint32_t INPUT_RING_HEADER_WORDS = 4;
+static constexpr uint32_t INPUT_RING_ENTRY_WORDS = 4;
+static constexpr int32_t INPUT_RING_POINTER = 0;
+static constexpr int32_t INPUT_RING_KEY = 1;
+static napi_ref g_inputRingRef = nullptr;
+static int32_t* g_inputRing = nullptr;
+static uint32_t g_inputRingCapacity = 0;
 
 // ---- TSFN for JS notifications (resize/disconnect only — NOT for frame updates) ----
 static napi_threadsafe_function g_tsfn = nullptr;
@@ -49,9 +78,10 @@ static napi_threadsafe_function g_tsfn = nullptr;
 // Pre-allocated notify data pool
 static constexpr int NOTIFY_POOL_SIZE = 4;
 struct VncNotifyData {
-    int status;         // 1=resize, -1=disconnected
+    int status;         // 1=resize, 2=reconnecting, 3=reconnected, -1=disconnected
     int fbWidth;
     int fbHeight;
+    int reconnectMs;    // status 3: time from the failure to the new handshake
     bool inUse;
 };
 static VncNotifyData g_notifyPool[NOTIFY_POOL_SIZE];
@@ -105,6 +135,8 @@ static void tsfnCallJs(napi_env env, napi_value js_cb, void* context, void* data
     napi_set_named_property(env, jsObj, "fbWidth", v);
     napi_create_int32(env, nd->fbHeight, &v);
     napi_set_named_property(env, jsObj, "fbHeight", v);
+    napi_create_int32(env, nd->reconnectMs, &v);
+    napi_set_named_property(env, jsObj, "reconnectMs", v);
 
     napi_value undefined;
     napi_get_undefined(env, &undefined);
@@ -114,6 +146,30 @@ static void tsfnCallJs(napi_env env, napi_value js_cb, void* context, void* data
 }
 
 // ---- VNC Poll Thread ----
+static void notifyStatus(int status, int fbWidth, int fbHeight, int reconnectMs = 0) {
+    auto* nd = allocNotifyData();
+    nd->status = status;
+    nd->fbWidth = fbWidth;
+    nd->fbHeight = fbHeight;
+    nd->reconnectMs = reconnectMs;
+    notifyJs(nd);
+}
+
+// Connection broke: reconnecting -> (new handshake) reconnected, or -1 when
+// the server stays away. The renderer keeps the last frame meanwhile
+static bool reconnectSession() {
+    notifyStatus(2, VncClient::getFrameWidth(), VncClient::getFrameHeight());
+    auto start = std::chrono::steady_clock::now();
+    if (!VncClient::reconnect(RECONNECT_TIMEOUT_MS, g_pollStopping)) {
+        return false;
+    }
+    int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    OH_LOG_INFO(LOG_APP, "Poll: reconnected in %{public}dms", ms);
+    notifyStatus(3, VncClient::getFrameWidth(), VncClient::getFrameHeight(), ms);
+    return true;
+}
+
 static void vncPollThread() {
     OH_LOG_INFO(LOG_APP, "VNC poll thread started");
 
@@ -124,8 +180,13 @@ static void vncPollThread() {
             break;
         }
 
+        // Renderer behind: let it present before asking for the next update
+        VncClient::waitForRenderer();
+
+        bool failed = false;
         {
             std::lock_guard<std::mutex> lock(VncClient::getSocketMutex());
+            VncClient::applyUpdateState();
             int i = WaitForMessage(cl, 50);
 
             if (!g_pollRunning.load()) break;
@@ -133,75 +194,166 @@ static void vncPollThread() {
             if (i < 0) {
                 OH_LOG_ERROR(LOG_APP, "Poll: WaitForMessage error (sock=%{public}d errno=%{public}d)",
                             cl->sock, errno);
-                auto* nd = allocNotifyData();
-                nd->status = -1; nd->fbWidth = 0; nd->fbHeight = 0;
-                notifyJs(nd);
-                break;
+                failed = true;
+            } else if (i > 0 && !HandleRFBServerMessage(cl)) {
+                OH_LOG_ERROR(LOG_APP, "Poll: HandleRFBServerMessage failed (sock=%{public}d errno=%{public}d)",
+                            cl->sock, errno);
+                failed = true;
             }
+        }
 
-            if (i > 0) {
-                if (!HandleRFBServerMessage(cl)) {
-                    OH_LOG_ERROR(LOG_APP, "Poll: HandleRFBServerMessage failed (sock=%{public}d errno=%{public}d)",
-                                cl->sock, errno);
-                    auto* nd = allocNotifyData();
-                    nd->status = -1; nd->fbWidth = 0; nd->fbHeight = 0;
-                    notifyJs(nd);
-                    break;
-                }
+        if (failed && !reconnectSession()) {
+            if (g_pollRunning.load()) {
+                notifyStatus(-1, 0, 0);
             }
+            break;
         }
     }
 
     OH_LOG_INFO(LOG_APP, "VNC poll thread stopped");
 }
 
+// Desktop size changed (VNC poll thread or QEMU main loop): wake render thread + notify JS
+static void onDesktopResize(int width, int height) {
+    OH_LOG_INFO(LOG_APP, "VNC resize: %{public}dx%{public}d", width, height);
+    VncRenderer::resize(-1, -1);
+    notifyStatus(1, width, height);
+}
+
 // ---- NAPI Functions ----
 
+// ---- vncInit: Promise<boolean>, connects on a worker thread ----
+// Workers run one at a time (g_connectMutex); vncClose or a newer vncInit
+// cancels the current one, which then tears its own client down
+static constexpr int CONNECT_TIMEOUT_MS = 60000;
+static constexpr int FIRST_UPDATE_TIMEOUT_MS = 10000;
+
+struct ConnectWork {
+    napi_async_work work;
+    napi_deferred deferred;
+    std::string address;
+    int32_t port;
+    std::string password;
+    VncPixelFormat format;
+    int32_t timeoutMs;
+    std::atomic<bool> cancel{false};
+    bool ok;
+};
+
+static ConnectWork* g_connectWork = nullptr;        // newest vncInit, JS thread only
+static std::mutex g_connectMutex;
+
+static void connectExecute(napi_env env, void* data) {
+    auto* cw = static_cast<ConnectWork*>(data);
+    std::lock_guard<std::mutex> lock(g_connectMutex);
+    cw->ok = false;
+    // Superseded before it started: the session (if any) belongs to a newer one
+    if (cw->cancel.load()) return;
+
+    cw->ok = VncClient::connectWhenReady(cw->address.c_str(), cw->port, cw->password.c_str(),
+                                         cw->format, cw->timeoutMs, cw->cancel) &&
+             VncClient::waitFirstUpdate(FIRST_UPDATE_TIMEOUT_MS, cw->cancel);
+    if (!cw->ok || cw->cancel.load()) {
+        VncClient::disconnect();
+        cw->ok = false;
+    }
+}
+
+static void connectComplete(napi_env env, napi_status status, void* data) {
+    auto* cw = static_cast<ConnectWork*>(data);
+    bool newest = g_connectWork == cw;
+    if (newest) {
+        g_connectWork = nullptr;
+    }
+    bool ok = status == napi_ok && cw->ok && !cw->cancel.load();
+    if (!ok && cw->ok && newest) {
+        // vncClose came after the worker finished: drop the session here. A
+        // superseded one is left to the newer connect, which replaces it
+        std::lock_guard<std::mutex> lock(g_connectMutex);
+        VncClient::disconnect();
+    } else if (ok) {
+        // Frame callback: markDirty() wakes render thread directly — no TSFN needed
+        VncClient::setFrameCallback([](const VncFrameInfo& info) {
+            VncRenderer::markDirty(info.x, info.y, info.w, info.h);
+        });
+        // Resize callback: wake render thread + notify JS
+        VncClient::setResizeCallback(onDesktopResize);
+        // The first update was decoded before anyone listened
+        onDesktopResize(VncClient::getFrameWidth(), VncClient::getFrameHeight());
+
+        if (VncClient::isLoopbackAddress(cw->address.c_str())) {
+            // In-process QEMU: display straight from its surface, VNC only carries input
+            DisplayBridge::setResizeCallback(onDesktopResize);
+            if (DisplayBridge::attach()) {
+                VncClient::setUpdatesEnabled(false);
+            }
+        }
+    }
+    OH_LOG_INFO(LOG_APP, "vncInit: %{public}s", ok ? "connected" : "failed");
+
+    napi_value result;
+    napi_get_boolean(env, ok, &result);
+    napi_resolve_deferred(env, cw->deferred, result);
+    napi_delete_async_work(env, cw->work);
+    delete cw;
+}
+
 static napi_value vncInit(napi_env env, napi_callback_info info) {
-    size_t argc = 3;
-    napi_value args[3] = {nullptr};
+    size_t argc = 5;
+    napi_value args[5] = {nullptr};
     napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
     if (status != napi_ok || argc < 3) {
         napi_throw_error(env, "-10", "Expected (address, port, password)");
         return nullptr;
     }
-
+    auto* cw = new ConnectWork();
     size_t addrLen = 0;
     napi_get_value_string_utf8(env, args[0], nullptr, 0, &addrLen);
-    std::string address(addrLen, '\0');
-    napi_get_value_string_utf8(env, args[0], &address[0], addrLen + 1, &addrLen);
+    cw->address.assign(addrLen, '\0');
+    napi_get_value_string_utf8(env, args[0], &cw->address[0], addrLen + 1, &addrLen);
 
-    int32_t port = 0;
-    napi_get_value_int32(env, args[1], &port);
+    napi_get_value_int32(env, args[1], &cw->port);
 
     size_t pwdLen = 0;
     napi_get_value_string_utf8(env, args[2], nullptr, 0, &pwdLen);
-    std::string password(pwdLen, '\0');
-    napi_get_value_string_utf8(env, args[2], &password[0], pwdLen + 1, &pwdLen);
-
-    OH_LOG_INFO(LOG_APP, "vncInit: %{public}s:%{public}d", address.c_str(), port);
-
-    bool ok = VncClient::connect(address.c_str(), port, password.c_str());
+    cw->password.assign(pwdLen, '\0');
+    napi_get_value_string_utf8(env, args[2], &cw->password[0], pwdLen + 1, &pwdLen);
+
+    // Optional pixel format: 'auto' (default), 'rgb565' or 'bgrx8888'
+    cw->format = VncPixelFormat::Auto;
+    napi_valuetype formatType = napi_undefined;
+    if (argc >= 4 && napi_typeof(env, args[3], &formatType) == napi_ok && formatType == napi_string) {
+        char formatName[16] = {};
+        size_t formatLen = 0;
+        napi_get_value_string_utf8(env, args[3], formatName, sizeof(formatName), &formatLen);
+        if (strcmp(formatName, "rgb565") == 0) {
+            cw->format = VncPixelFormat::Rgb565;
+        } else if (strcmp(formatName, "bgrx8888") == 0) {
+            cw->format = VncPixelFormat::Bgrx8888;
+        }
+    }
 
-    // Frame callback: markDirty() wakes render thread directly — no TSFN needed
-    VncClient::setFrameCallback([](const VncFrameInfo& info) {
-        VncRenderer::markDirty(info.x, info.y, info.w, info.h);
-    });
+    // Optional time to wait for the server to start listening
+    cw->timeoutMs = CONNECT_TIMEOUT_MS;
+    napi_valuetype timeoutType = napi_undefined;
+    if (argc >= 5 && napi_typeof(env, args[4], &timeoutType) == napi_ok && timeoutType == napi_number) {
+        napi_get_value_int32(env, args[4], &cw->timeoutMs);
+    }
 
-    // Resize callback: wake render thread + notify JS
-    VncClient::setResizeCallback([](int width, int height) {
-        OH_LOG_INFO(LOG_APP, "VNC resize: %{public}dx%{public}d", width, height);
-        VncRenderer::resize(-1, -1);
-        auto* nd = allocNotifyData();
-        nd->status = 1;
-        nd->fbWidth = width;
-        nd->fbHeight = height;
-        notifyJs(nd);
-    });
+    OH_LOG_INFO(LOG_APP, "vncInit: %{public}s:%{public}d", cw->address.c_str(), cw->port);
 
-    napi_value ret;
-    napi_get_boolean(env, ok, &ret);
-    return ret;
+    // Leaving and re-entering the page must not wait for the old handshake
+    if (g_connectWork) {
+        g_connectWork->cancel.store(true);
+        VncClient::abortConnect();
+    }
+    g_connectWork = cw;
+    napi_value promise, name;
+    napi_create_promise(env, &cw->deferred, &promise);
+    napi_create_string_utf8(env, "vncInit", NAPI_AUTO_LENGTH, &name);
+    napi_create_async_work(env, nullptr, name, connectExecute, connectComplete, cw, &cw->work);
+    napi_queue_async_work(env, cw->work);
+    return promise;
 }
 
 static napi_value vncClose(napi_env env, napi_callback_info info) {
@@ -211,21 +363,32 @@ static napi_value vncClose(napi_env env, napi_callback_info info) {
     {
         std::lock_guard<std::mutex> lock(g_pollMutex);
         g_pollRunning.store(false);
+        g_pollStopping.store(true);
+        VncClient::abortConnect();     // a reconnect handshake would block the join
         if (g_pollThread.joinable()) {
             g_pollThread.join();
         }
     }
 
-    // 2. Release TSFN
+    // 2. Stop reading QEMU's surface (no callback after this)
+    DisplayBridge::detach();
+
+    // 3. Release TSFN
     if (g_tsfn != nullptr) {
         napi_release_threadsafe_function(g_tsfn, napi_tsfn_release);
         g_tsfn = nullptr;
     }
 
-    // 3. Destroy VNC client
-    VncClient::disconnect();
+    // 4. Destroy VNC client; a connect still in flight is only cancelled here
+    // (its worker may be inside the handshake) and tears itself down
+    if (g_connectWork) {
+        g_connectWork->cancel.store(true);
+        VncClient::abortConnect();
+    } else {
+        VncClient::disconnect();
+    }
 
-    // 4. Shutdown renderer (stops render thread + cleans up GL)
+    // 5. Shutdown renderer (stops render thread + cleans up GL)
     VncRenderer::shutdown();
 
     napi_value ret;
@@ -264,6 +427,73 @@ static napi_value vncKeyEvent(napi_env env, napi_callback_info info) {
     return nullptr;
 }
 
+// vncSetInputRing(buffer: ArrayBuffer | null): boolean
+// Registers the ring vncFlushInput drains; null releases it
+static napi_value vncSetInputRing(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+
+    if (g_inputRingRef) {
+        napi_delete_reference(env, g_inputRingRef);
+        g_inputRingRef = nullptr;
+    }
+    g_inputRing = nullptr;
+    g_inputRingCapacity = 0;
+
+    bool ok = false;
+    void* data = nullptr;
+    size_t length = 0;
+    if (argc >= 1 && napi_get_arraybuffer_info(env, args[0], &data, &length) == napi_ok &&
+        length >= INPUT_RING_HEADER_WORDS * sizeof(int32_t)) {
+        auto* ring = static_cast<int32_t*>(data);
+        uint32_t capacity = static_cast<uint32_t>(ring[2]);
+        size_t needed = (INPUT_RING_HEADER_WORDS + static_cast<size_t>(capacity) * INPUT_RING_ENTRY_WORDS) *
+                        sizeof(int32_t);
+        if (capacity > 0 && (capacity & (capacity - 1)) == 0 && length >= needed) {
+            napi_create_reference(env, args[0], 1, &g_inputRingRef);
+            g_inputRing = ring;
+            g_inputRingCapacity = capacity;
+            ok = true;
+        } else {
+            OH_LOG_ERROR(LOG_APP, "Input ring rejected: capacity=%{public}u, bytes=%{public}zu", capacity, length);
+        }
+    }
+
+    napi_value ret;
+    napi_get_boolean(env, ok, &ret);
+    return ret;
+}
+
+// vncFlushInput(): number
+// Queues every entry JS wrote since the last flush; returns how many
+static napi_value vncFlushInput(napi_env env, napi_callback_info info) {
+    uint32_t count = 0;
+    if (g_inputRing) {
+        uint32_t writeIndex = static_cast<uint32_t>(g_inputRing[0]);
+        uint32_t readIndex = static_cast<uint32_t>(g_inputRing[1]);
+        if (writeIndex - readIndex > g_inputRingCapacity) {
+            OH_LOG_ERROR(LOG_APP, "Input ring overrun, dropping %{public}u entries", writeIndex - readIndex);
+            readIndex = writeIndex;
+        }
+        int32_t* entries = g_inputRing + INPUT_RING_HEADER_WORDS;
+        for (; readIndex != writeIndex; readIndex++, count++) {
+            const int32_t* e = entries + (readIndex & (g_inputRingCapacity - 1)) * INPUT_RING_ENTRY_WORDS;
+            if (e[0] == INPUT_RING_POINTER) {
+                VncClient::sendMouseEvent(e[1], e[2], e[3]);
+            } else if (e[0] == INPUT_RING_KEY) {
+                rfbKeySym keysym = ohKeyCode2RFBKeyCode(static_cast<Input_KeyCode>(e[1]), e[2] ? TRUE : FALSE);
+                VncClient::sendKeyEvent(keysym, e[2] != 0);
+            }
+        }
+        g_inputRing[1] = static_cast<int32_t>(readIndex);
+    }
+
+    napi_value ret;
+    napi_create_uint32(env, count, &ret);
+    return ret;
+}
+
 static napi_value vncStartUpdateLoop(napi_env env, napi_callback_info info) {
     size_t argc = 1;
     napi_value args[1] = {nullptr};
@@ -294,20 +524,19 @@ static napi_value vncStartUpdateLoop(napi_env env, napi_callback_info info) {
 
     if (g_pollThread.joinable()) {
         g_pollRunning.store(false);
+        g_pollStopping.store(true);
+        VncClient::abortConnect();
         g_pollThread.join();
     }
 
     g_pollRunning.store(true);
+    g_pollStopping.store(false);
     g_pollThread = std::thread(vncPollThread);
 
     // Send initial VNC dimensions to JS
     rfbClient* cl = VncClient::getClient();
     if (cl && g_tsfn) {
-        auto* nd = allocNotifyData();
-        nd->status = 1;
-        nd->fbWidth = cl->width;
-        nd->fbHeight = cl->height;
-        notifyJs(nd);
+        notifyStatus(1, cl->width, cl->height);
     }
 
     OH_LOG_INFO(LOG_APP, "vncStartUpdateLoop: thread started");
@@ -322,6 +551,8 @@ static napi_value vncStopUpdateLoop(napi_env env, napi_callback_info info) {
 
     std::lock_guard<std::mutex> lock(g_pollMutex);
     g_pollRunning.store(false);
+    g_pollStopping.store(true);
+    VncClient::abortConnect();
     if (g_pollThread.joinable()) {
         g_pollThread.join();
     }
@@ -335,8 +566,8 @@ static napi_value vncStopUpdateLoop(napi_env env, napi_callback_info info) {
 }
 
 static napi_value vncCreateSurface(napi_env env, napi_callback_info info) {
-    size_t argc = 1;
-    napi_value args[1] = {nullptr};
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
     napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
     if (status != napi_ok || argc < 1) return nullptr;
 
@@ -356,13 +587,178 @@ static napi_value vncCreateSurface(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
+    // Optional cache directory for the linked shader program binary
+    napi_valuetype dirType;
+    if (argc >= 2 && napi_typeof(env, args[1], &dirType) == napi_ok && dirType == napi_string) {
+        size_t dirLen = 0;
+        napi_get_value_string_utf8(env, args[1], nullptr, 0, &dirLen);
+        std::string cacheDir(dirLen, '\0');
+        napi_get_value_string_utf8(env, args[1], &cacheDir[0], dirLen + 1, &dirLen);
+        VncRenderer::setProgramCacheDir(cacheDir.c_str());
+    }
+
     bool result = VncRenderer::init(surfaceId);
+    if (result) {
+        // Something draws again: resume with one full update
+        VncClient::setSurfaceAttached(true);
+    }
 
     napi_value ret;
     napi_get_boolean(env, result, &ret);
     return ret;
 }
 
+// ---- Thumbnail capture: Promise<{ width, height, data: ArrayBuffer (RGBA) } | null> ----
+// Rendering happens on the render thread (headless if there is no surface);
+// the async work thread just waits for it so the JS thread never blocks.
+struct CaptureWork {
+    napi_async_work work;
+    napi_deferred deferred;
+    int maxWidth;
+    int maxHeight;
+    std::vector<uint8_t> rgba;
+    int width;
+    int height;
+    bool ok;
+};
+
+static void captureExecute(napi_env env, void* data) {
+    auto* cw = static_cast<CaptureWork*>(data);
+    cw->ok = VncRenderer::captureThumbnail(cw->maxWidth, cw->maxHeight, cw->rgba, cw->width, cw->height);
+}
+
+static void captureComplete(napi_env env, napi_status status, void* data) {
+    auto* cw = static_cast<CaptureWork*>(data);
+    napi_value result;
+    if (status == napi_ok && cw->ok) {
+        napi_create_object(env, &result);
+        napi_value val;
+        napi_create_int32(env, cw->width, &val);
+        napi_set_named_property(env, result, "width", val);
+        napi_create_int32(env, cw->height, &val);
+        napi_set_named_property(env, result, "height", val);
+        void* buf = nullptr;
+        napi_create_arraybuffer(env, cw->rgba.size(), &buf, &val);
+        memcpy(buf, cw->rgba.data(), cw->rgba.size());
+        napi_set_named_property(env, result, "data", val);
+    } else {
+        napi_get_null(env, &result);
+    }
+    napi_resolve_deferred(env, cw->deferred, result);
+    napi_delete_async_work(env, cw->work);
+    delete cw;
+}
+
+static napi_value vncCaptureThumbnail(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
+    napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (status != napi_ok || argc < 2) {
+        napi_throw_error(env, "-10", "Expected (maxWidth, maxHeight)");
+        return nullptr;
+    }
+
+    auto* cw = new CaptureWork();
+    napi_get_value_int32(env, args[0], &cw->maxWidth);
+    napi_get_value_int32(env, args[1], &cw->maxHeight);
+
+    napi_value promise, name;
+    napi_create_promise(env, &cw->deferred, &promise);
+    napi_create_string_utf8(env, "vncCaptureThumbnail", NAPI_AUTO_LENGTH, &name);
+    napi_create_async_work(env, nullptr, name, captureExecute, captureComplete, cw, &cw->work);
+    napi_queue_async_work(env, cw->work);
+    return promise;
+}
+
+// ---- Render stats: { frames, fps, coalescedTotal, gpuTiming, <metric>: {p50, p95, p99, max} } ----
+static napi_value makePercentiles(napi_env env, const StatPercentiles& p) {
+    napi_value obj, val;
+    napi_create_object(env, &obj);
+    napi_create_uint32(env, p.p50, &val);
+    napi_set_named_property(env, obj, "p50", val);
+    napi_create_uint32(env, p.p95, &val);
+    napi_set_named_property(env, obj, "p95", val);
+    napi_create_uint32(env, p.p99, &val);
+    napi_set_named_property(env, obj, "p99", val);
+    napi_create_uint32(env, p.max, &val);
+    napi_set_named_property(env, obj, "max", val);
+    return obj;
+}
+
+static napi_value vncGetRenderStats(napi_env env, napi_callback_info info) {
+    RenderStatsSummary s = VncRenderer::getStats();
+
+    napi_value obj, val;
+    napi_create_object(env, &obj);
+    napi_create_uint32(env, s.frames, &val);
+    napi_set_named_property(env, obj, "frames", val);
+    napi_create_double(env, s.fps, &val);
+    napi_set_named_property(env, obj, "fps", val);
+    napi_create_uint32(env, s.coalescedTotal, &val);
+    napi_set_named_property(env, obj, "coalescedTotal", val);
+    napi_get_boolean(env, s.gpuTiming, &val);
+    napi_set_named_property(env, obj, "gpuTiming", val);
+    napi_set_named_property(env, obj, "uploadBytes", makePercentiles(env, s.uploadBytes));
+    napi_set_named_property(env, obj, "uploadRects", makePercentiles(env, s.uploadRects));
+    napi_set_named_property(env, obj, "uploadUs", makePercentiles(env, s.uploadUs));
+    napi_set_named_property(env, obj, "gpuUs", makePercentiles(env, s.gpuUs));
+    napi_set_named_property(env, obj, "swapUs", makePercentiles(env, s.swapUs));
+    napi_set_named_property(env, obj, "frameUs", makePercentiles(env, s.frameUs));
+    return obj;
+}
+
+static napi_value vncGetEncodingStats(napi_env env, napi_callback_info info) {
+    EncodingTunerStats s = VncClient::getEncodingStats();
+
+    napi_value obj, val;
+    napi_create_object(env, &obj);
+    napi_get_boolean(env, s.local, &val);
+    napi_set_named_property(env, obj, "local", val);
+    napi_get_boolean(env, s.tuned, &val);
+    napi_set_named_property(env, obj, "tuned", val);
+    const EncodingProfile& current = EncodingTuner::PROFILES[s.profile];
+    napi_create_string_utf8(env, current.name, NAPI_AUTO_LENGTH, &val);
+    napi_set_named_property(env, obj, "profile", val);
+    napi_create_string_utf8(env, current.encodings, NAPI_AUTO_LENGTH, &val);
+    napi_set_named_property(env, obj, "encodings", val);
+    napi_create_int32(env, current.compressLevel, &val);
+    napi_set_named_property(env, obj, "compressLevel", val);
+    napi_create_int32(env, s.qualityLevel, &val);
+    napi_set_named_property(env, obj, "qualityLevel", val);
+    napi_create_uint32(env, s.rttUs, &val);
+    napi_set_named_property(env, obj, "rttUs", val);
+    napi_create_uint32(env, s.minRttUs, &val);
+    napi_set_named_property(env, obj, "minRttUs", val);
+    napi_create_double(env, s.throughputKbps, &val);
+    napi_set_named_property(env, obj, "throughputKbps", val);
+    napi_create_uint32(env, s.switches, &val);
+    napi_set_named_property(env, obj, "switches", val);
+
+    // Only profiles that were actually used
+    napi_value profiles;
+    napi_create_array(env, &profiles);
+    uint32_t n = 0;
+    for (int i = 0; i < EncodingTuner::PROFILE_COUNT; i++) {
+        const EncodingProfileStats& p = s.profiles[i];
+        if (p.updates == 0) continue;
+        napi_value entry;
+        napi_create_object(env, &entry);
+        napi_create_string_utf8(env, EncodingTuner::PROFILES[i].name, NAPI_AUTO_LENGTH, &val);
+        napi_set_named_property(env, entry, "profile", val);
+        napi_create_double(env, static_cast<double>(p.updates), &val);
+        napi_set_named_property(env, entry, "updates", val);
+        napi_create_double(env, p.pixels / 1e6, &val);
+        napi_set_named_property(env, entry, "mpixels", val);
+        napi_create_double(env, p.bytesPerPixel, &val);
+        napi_set_named_property(env, entry, "bytesPerPixel", val);
+        napi_create_double(env, p.decodeUsPerMpx, &val);
+        napi_set_named_property(env, entry, "decodeUsPerMpx", val);
+        napi_set_element(env, profiles, n++, entry);
+    }
+    napi_set_named_property(env, obj, "profiles", profiles);
+    return obj;
+}
+
 static napi_value vncResizeSurface(napi_env env, napi_callback_info info) {
     size_t argc = 3;
     napi_value args[3] = {nullptr};
@@ -374,14 +770,72 @@ static napi_value vncResizeSurface(napi_env env, napi_callback_info info) {
     napi_get_value_int32(env, args[2], &height);
 
     VncRenderer::resize(width, height);
+    // Let the guest render at the surface's native size (debounced)
+    VncClient::requestDesktopSize(width, height);
 
     napi_value ret;
     napi_create_int32(env, 0, &ret);
     return ret;
 }
 
+// Page visibility (hidden / app in background with the surface kept); ANDed
+// with the surface being attached, so neither can resume updates for the other
+static napi_value vncSetSurfaceVisible(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (status != napi_ok || argc < 1) return nullptr;
+
+    bool visible = true;
+    napi_get_value_bool(env, args[0], &visible);
+    VncClient::setPageVisible(visible);
+    return nullptr;
+}
+
+static napi_value vncSetFrameRateCap(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (status != napi_ok || argc < 1) return nullptr;
+
+    int32_t fps = 0;
+    napi_get_value_int32(env, args[0], &fps);
+    VncRenderer::setFrameRateCap(fps);
+    return nullptr;
+}
+
+// How many frames decoding may run ahead of presenting (0 = unpaced)
+static napi_value vncSetFrameLead(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (status != napi_ok || argc < 1) return nullptr;
+
+    int32_t frames = 0;
+    napi_get_value_int32(env, args[0], &frames);
+    VncClient::setFrameLead(frames);
+    return nullptr;
+}
+
+static napi_value vncSetViewTransform(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3] = {nullptr};
+    napi_status status = napi_get_cb_info(env, info, &argc, args, nullptr, nullptr);
+    if (status != napi_ok || argc < 3) return nullptr;
+
+    double zoom = 1.0, panX = 0.0, panY = 0.0;
+    napi_get_value_double(env, args[0], &zoom);
+    napi_get_value_double(env, args[1], &panX);
+    napi_get_value_double(env, args[2], &panY);
+    VncRenderer::setViewTransform(static_cast<float>(zoom), static_cast<float>(panX), static_cast<float>(panY));
+    return nullptr;
+}
+
+// Window is gone: keep the GL context and textures for the next vncCreateSurface
 static napi_value vncDestroySurface(napi_env env, napi_callback_info info) {
-    VncRenderer::shutdown();
+    VncRenderer::detachSurface();
+    // Nothing is drawn: stop receiving and decoding updates
+    VncClient::setSurfaceAttached(false);
 
     napi_value ret;
     napi_create_int32(env, 0, &ret);
@@ -395,11 +849,20 @@ void registerVncFunctions(napi_env env, napi_value exports) {
         {"vncClose", nullptr, vncClose, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncMouseEvent", nullptr, vncMouseEvent, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncKeyEvent", nullptr, vncKeyEvent, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncSetInputRing", nullptr, vncSetInputRing, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncFlushInput", nullptr, vncFlushInput, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncStartUpdateLoop", nullptr, vncStartUpdateLoop, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncStopUpdateLoop", nullptr, vncStopUpdateLoop, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncCreateSurface", nullptr, vncCreateSurface, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncResizeSurface", nullptr, vncResizeSurface, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"vncDestroySurface", nullptr, vncDestroySurface, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncSetSurfaceVisible", nullptr, vncSetSurfaceVisible, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncCaptureThumbnail", nullptr, vncCaptureThumbnail, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncGetEncodingStats", nullptr, vncGetEncodingStats, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncGetRenderStats", nullptr, vncGetRenderStats, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncSetFrameRateCap", nullptr, vncSetFrameRateCap, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncSetFrameLead", nullptr, vncSetFrameLead, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"vncSetViewTransform", nullptr, vncSetViewTransform, nullptr, nullptr, nullptr, napi_default, nullptr},
     };
     napi_define_properties(env, exports, sizeof(desc) / sizeof(desc[0]), desc);
 }
@@ -0,0 +1,99 @@
+//
+// Render Statistics Implementation for HiSH
+//
+
+#include "include/render_stats.hpp"
+#include <algorithm>
+#include <cstring>
+
+void RenderStatsRing::push(const FrameStats& stats) {
+    uint32_t n = head_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[n % CAPACITY];
+
+    uint32_t words[WORDS];
+    memcpy(words, &stats, sizeof(words));
+
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);     // odd: writing
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < WORDS; i++) {
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    slot.seq.store(seq + 2, std::memory_order_release);     // even: stable
+    head_.store(n + 1, std::memory_order_release);
+}
+
+bool RenderStatsRing::read(int index, FrameStats& out) const {
+    const Slot& slot = slots_[index];
+    uint32_t before = slot.seq.load(std::memory_order_acquire);
+    if (before & 1) return false;
+
+    uint32_t words[WORDS];
+    for (int i = 0; i < WORDS; i++) {
+        words[i] = slot.words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != before) return false;
+
+    memcpy(&out, words, sizeof(words));
+    return true;
+}
+
+void RenderStatsRing::clear() {
+    head_.store(0, std::memory_order_release);
+}
+
+static StatPercentiles percentiles(uint32_t* values, int count) {
+    StatPercentiles p = {0, 0, 0, 0};
+    if (count == 0) return p;
+    std::sort(values, values + count);
+    auto at = [&](int pct) { return values[std::min(count - 1, count * pct / 100)]; };
+    p.p50 = at(50);
+    p.p95 = at(95);
+    p.p99 = at(99);
+    p.max = values[count - 1];
+    return p;
+}
+
+RenderStatsSummary RenderStatsRing::summarize() const {
+    RenderStatsSummary s = {};
+
+    uint32_t head = head_.load(std::memory_order_acquire);
+    int available = static_cast<int>(std::min<uint32_t>(head, CAPACITY));
+
+    // Snapshot oldest to newest; slots overwritten meanwhile are skipped
+    FrameStats frames[CAPACITY];
+    int count = 0;
+    for (int i = 0; i < available; i++) {
+        int index = static_cast<int>((head - available + i) % CAPACITY);
+        if (read(index, frames[count])) count++;
+    }
+    s.frames = count;
+    if (count == 0) return s;
+
+    if (count > 1) {
+        uint32_t spanMs = frames[count - 1].timestampMs - frames[0].timestampMs;
+        s.fps = spanMs > 0 ? (count - 1) * 1000.0f / spanMs : 0.0f;
+    }
+
+    uint32_t values[CAPACITY];
+    auto column = [&](uint32_t FrameStats::*field) {
+        for (int i = 0; i < count; i++) values[i] = frames[i].*field;
+        return percentiles(values, count);
+    };
+    s.uploadBytes = column(&FrameStats::uploadBytes);
+    s.uploadRects = column(&FrameStats::uploadRects);
+    s.uploadUs = column(&FrameStats::uploadUs);
+    s.swapUs = column(&FrameStats::swapUs);
+    s.frameUs = column(&FrameStats::frameUs);
+
+    // GPU time only over frames that have a measurement
+    int gpuCount = 0;
+    for (int i = 0; i < count; i++) {
+        s.coalescedTotal += frames[i].coalesced;
+        if (frames[i].gpuUs > 0) values[gpuCount++] = frames[i].gpuUs;
+    }
+    s.gpuTiming = gpuCount > 0;
+    s.gpuUs = percentiles(values, gpuCount);
+    return s;
+}
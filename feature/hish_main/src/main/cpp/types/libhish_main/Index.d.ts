@@ -16,13 +16,69 @@ export const createSnapshot: (imagePath: string, snapshotName: string) => string
 export const applySnapshot: (imagePath: string, snapshotName: string) => string;
 export const deleteSnapshot: (imagePath: string, snapshotName: string) => string;
 export const optimizeImage: (imagePath: string, outputPath: string, mode: 'sparse' | 'prealloc' | 'cleanup' | 'optimize') => string;
-export const vncInit: (address: string, port: number, password: string) => boolean;
+export type VncPixelFormat = 'auto' | 'rgb565' | 'bgrx8888';
+// Resolves once the first complete framebuffer update has been received;
+// retries with backoff for up to timeoutMs (default 60 s) while the server is
+// not listening yet. false on failure or when vncClose() cancelled it
+export const vncInit: (address: string, port: number, password: string, pixelFormat?: VncPixelFormat,
+  timeoutMs?: number) => Promise<boolean>;
 export const vncClose: () => number;
 export const vncMouseEvent: (x: number, y: number, buttonMask: number) => void;
 export const vncKeyEvent: (keyCode: number, down: boolean) => void;
-export interface VncPollResult { status: number; fbWidth: number; fbHeight: number; }
+export const vncSetInputRing: (buffer: ArrayBuffer | null) => boolean;
+export const vncFlushInput: () => number;
+// status: 1 = resize, 2 = reconnecting, 3 = reconnected (after reconnectMs), -1 = disconnected
+export interface VncPollResult { status: number; fbWidth: number; fbHeight: number; reconnectMs: number; }
 export const vncStartUpdateLoop: (onStatusUpdate: (result: VncPollResult) => void) => boolean;
 export const vncStopUpdateLoop: () => void;
-export const vncCreateSurface: (surfaceId: bigint) => boolean;
+export const vncCreateSurface: (surfaceId: bigint, cacheDir?: string) => boolean;
 export const vncResizeSurface: (surfaceId: bigint, width: number, height: number) => number;
 export const vncDestroySurface: () => number;
+// Page hidden (false) / shown (true). Framebuffer updates run only while the
+// page is shown and a surface exists (vncCreateSurface .. vncDestroySurface)
+export const vncSetSurfaceVisible: (visible: boolean) => void;
+export interface VncThumbnail { width: number; height: number; data: ArrayBuffer; }
+export const vncCaptureThumbnail: (maxWidth: number, maxHeight: number) => Promise<VncThumbnail | null>;
+export interface VncStatPercentiles { p50: number; p95: number; p99: number; max: number; }
+export interface VncRenderStats {
+  frames: number;
+  fps: number;
+  coalescedTotal: number;
+  gpuTiming: boolean;
+  uploadBytes: VncStatPercentiles;
+  uploadRects: VncStatPercentiles;
+  uploadUs: VncStatPercentiles;
+  gpuUs: VncStatPercentiles;
+  swapUs: VncStatPercentiles;
+  frameUs: VncStatPercentiles;
+}
+export const vncGetRenderStats: () => VncRenderStats;
+export interface VncEncodingProfileStats {
+  profile: string;
+  updates: number;
+  mpixels: number;
+  bytesPerPixel: number;
+  decodeUsPerMpx: number;
+}
+export interface VncEncodingStats {
+  local: boolean;
+  // False while the profile is pinned: local links stay on raw for the whole
+  // session, and links without TCP_INFO are never re-evaluated
+  tuned: boolean;
+  profile: string;
+  encodings: string;
+  compressLevel: number;
+  // JPEG quality (0-9), tuned only on the tight profile
+  qualityLevel: number;
+  rttUs: number;
+  minRttUs: number;
+  throughputKbps: number;
+  switches: number;
+  profiles: VncEncodingProfileStats[];
+}
+export const vncGetEncodingStats: () => VncEncodingStats;
+export const vncSetFrameRateCap: (fps: number) => void;
+// Frames decoding may run ahead of the renderer before the next update is
+// requested (default 2, 0 = request as fast as the server sends)
+export const vncSetFrameLead: (frames: number) => void;
+export const vncSetViewTransform: (zoom: number, panX: number, panY: number) => void;
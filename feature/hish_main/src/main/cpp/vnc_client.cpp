@@ -1,16 +1,25 @@
 //
 // VNC Client Implementation for HiSH
-// Wraps libvncclient with RGB565 format and thread-safe callbacks
+// Wraps libvncclient with a negotiable pixel format and thread-safe callbacks
 //
 
 #include "include/vnc_client.hpp"
+#include "include/display_bridge.hpp"
 #include "hilog/log.h"
 #include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include <atomic>
+#include <cerrno>
 #include <cstdarg>
 
 #undef LOG_DOMAIN
@@ -18,6 +27,21 @@
 #define LOG_DOMAIN 0x3301
 #define LOG_TAG "VNCClient"
 
+// poll() in short slices so a cancel is noticed while connecting
+static bool waitSocket(int sock, short events, int timeoutMs, const std::atomic<bool>& cancel) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!cancel.load()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0) return false;
+        struct pollfd pfd = {sock, events, 0};
+        int ready = poll(&pfd, 1, static_cast<int>(std::min<long long>(left, 50)));
+        if (ready > 0) return (pfd.revents & events) != 0;
+        if (ready < 0 && errno != EINTR) return false;
+    }
+    return false;
+}
+
 // Redirect libvncserver logs to HiLog
 static void hishVncLog(const char* format, ...) {
     char buf[512];
@@ -43,37 +67,167 @@ static void hishVncErr(const char* format, ...) {
     OH_LOG_ERROR(LOG_APP, "libvnc: %{public}s", buf);
 }
 
+// Every message libvncclient or we send goes through WriteToRFBServer; the
+// link wraps it (-Wl,--wrap=WriteToRFBServer) so concurrent senders, including
+// libvncclient's own update requests inside HandleRFBServerMessage, each get
+// the socket for a whole message
+extern "C" rfbBool __real_WriteToRFBServer(rfbClient* client, const char* buf, unsigned int n);
+
+extern "C" rfbBool __wrap_WriteToRFBServer(rfbClient* client, const char* buf, unsigned int n) {
+    static std::mutex sendMutex;
+    std::lock_guard<std::mutex> lock(sendMutex);
+    return __real_WriteToRFBServer(client, buf, n);
+}
+
+// Reads are wrapped the same way to time those that go to the socket (and may
+// wait for data), so the tuner sees decode time without receive time. Reads
+// served from libvncclient's buffer are left untimed. Poll thread, or the
+// connect worker before it starts
+static uint64_t g_socketReadNs = 0;
+
+extern "C" rfbBool __real_ReadFromRFBServer(rfbClient* client, char* out, unsigned int n);
+
+extern "C" rfbBool __wrap_ReadFromRFBServer(rfbClient* client, char* out, unsigned int n) {
+    if (n <= client->buffered) {
+        return __real_ReadFromRFBServer(client, out, n);
+    }
+    auto start = std::chrono::steady_clock::now();
+    rfbBool ok = __real_ReadFromRFBServer(client, out, n);
+    g_socketReadNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return ok;
+}
+
 // Static member initialization
 rfbClient* VncClient::client_ = nullptr;
 std::atomic<bool> VncClient::connected_(false);
 char VncClient::password_[256] = {};
 
-uint8_t* VncClient::frameBuffer_ = nullptr;
-int VncClient::fbWidth_ = 0;
-int VncClient::fbHeight_ = 0;
-std::mutex VncClient::fbMutex_;
+FrameExchange VncClient::frames_;
+DamageRegion VncClient::updateDamage_;
+std::atomic<int> VncClient::fbWidth_(0);
+std::atomic<int> VncClient::fbHeight_(0);
 
 VncResizeCallback VncClient::resizeCallback_ = nullptr;
 VncFrameCallback VncClient::frameCallback_ = nullptr;
 std::mutex VncClient::socketMutex_;
 
+VncPixelFormat VncClient::pixelFormat_ = VncPixelFormat::Rgb565;
+std::chrono::steady_clock::time_point VncClient::updateStart_;
+bool VncClient::updateInProgress_ = false;
+uint64_t VncClient::updateReadNs_ = 0;
+uint64_t VncClient::statUpdates_ = 0;
+uint64_t VncClient::statPixels_ = 0;
+uint64_t VncClient::statUpdateNs_ = 0;
+uint64_t VncClient::updatePixels_ = 0;
+EncodingTuner VncClient::tuner_;
+JpegDecoder VncClient::jpeg_;
+std::string VncClient::address_;
+int VncClient::port_ = 0;
+std::mutex VncClient::handshakeMutex_;
+int VncClient::handshakeSock_ = RFB_INVALID_SOCKET;
+
+InputQueue VncClient::inputQueue_;
+const int VncClient::inputEventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+std::atomic<int> VncClient::inputProducers_(0);
+std::thread VncClient::writerThread_;
+std::atomic<bool> VncClient::writerRunning_(false);
+std::mutex VncClient::writeMutex_;
+std::atomic<uint64_t> VncClient::statInputDropped_(0);
+uint64_t VncClient::statMotionCoalesced_ = 0;
+
+bool VncClient::updatesEnabled_ = true;
+std::atomic<bool> VncClient::updatesRequested_(true);
+std::atomic<bool> VncClient::pageVisible_(true);
+std::atomic<bool> VncClient::surfaceAttached_(true);
+bool VncClient::cuSupported_ = false;
+bool VncClient::cuActive_ = false;
+bool VncClient::fenceSupported_ = false;
+int VncClient::fencesInFlight_ = 0;
+uint64_t VncClient::statFenceThrottled_ = 0;
+
+std::atomic<int> VncClient::frameLead_(FRAME_LEAD_DEFAULT);
+bool VncClient::requestHeld_ = false;
+bool VncClient::requestDeferred_ = false;
+std::chrono::steady_clock::time_point VncClient::deferredSince_;
+uint64_t VncClient::statRequestsDeferred_ = 0;
+uint64_t VncClient::statDeferTimeouts_ = 0;
+
+std::atomic<bool> VncClient::extDesktopSizeSupported_(false);
+std::atomic<uint32_t> VncClient::screenId_(0);
+std::atomic<uint32_t> VncClient::screenFlags_(0);
+std::mutex VncClient::desktopSizeMutex_;
+bool VncClient::desktopSizePending_ = false;
+int VncClient::wantedWidth_ = 0;
+int VncClient::wantedHeight_ = 0;
+std::chrono::steady_clock::time_point VncClient::desktopSizeDue_;
+
+// ContinuousUpdates / Fence extensions (RFB community registry)
+static constexpr int ENCODING_FENCE = -312;
+static constexpr int ENCODING_CONTINUOUS_UPDATES = -313;
+static constexpr uint8_t MSG_END_OF_CONTINUOUS_UPDATES = 150;   // server -> client
+static constexpr uint8_t MSG_ENABLE_CONTINUOUS_UPDATES = 150;   // client -> server
+static constexpr uint8_t MSG_FENCE = 248;                       // both directions
+static constexpr uint32_t FENCE_BLOCK_BEFORE = 1u << 0;
+static constexpr uint32_t FENCE_BLOCK_AFTER = 1u << 1;
+static constexpr uint32_t FENCE_REQUEST = 1u << 31;
+static constexpr uint8_t FENCE_MAX_PAYLOAD = 64;
+
+// ExtendedDesktopSize pseudo-rect + SetDesktopSize
+static constexpr int ENCODING_EXT_DESKTOP_SIZE = -308;
+static constexpr uint8_t MSG_SET_DESKTOP_SIZE = 251;
+static constexpr int MAX_DESKTOP_SIZE = 8192;
+
+// Appended to SetEncodings by libvncclient; unknown server messages are
+// offered to handleMessage
+static int g_extensionEncodings[] = {
+    ENCODING_CONTINUOUS_UPDATES, ENCODING_FENCE, ENCODING_EXT_DESKTOP_SIZE, 0
+};
+static rfbClientProtocolExtension g_extension = {
+    g_extensionEncodings,
+    nullptr,    // handlers set in createClient (private members)
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+static const char* pixelFormatName(VncPixelFormat format) {
+    switch (format) {
+        case VncPixelFormat::Rgb565: return "rgb565";
+        case VncPixelFormat::Bgrx8888: return "bgrx8888";
+        default: return "auto";
+    }
+}
+
 rfbBool VncClient::onResize(rfbClient* cl) {
-    size_t size = static_cast<size_t>(cl->height) * cl->width * cl->format.bitsPerPixel / 8;
     OH_LOG_INFO(LOG_APP, "Resize: %{public}dx%{public}d bpp=%{public}d",
                 cl->width, cl->height, cl->format.bitsPerPixel);
 
-    {
-        std::lock_guard<std::mutex> lock(fbMutex_);
-        delete[] frameBuffer_;
-        frameBuffer_ = new uint8_t[size];
-        memset(frameBuffer_, 0, size);
-        cl->frameBuffer = frameBuffer_;
+    // Only the back buffer is touched; the renderer keeps reading the last
+    // published frame until the first update at the new size is complete
+    jpeg_.waitAll();
+    bool sizeChanged = cl->width != fbWidth_.load() || cl->height != fbHeight_.load();
+    cl->frameBuffer = frames_.resize(cl->width, cl->height, cl->format.bitsPerPixel / 8);
+    if (!cl->frameBuffer) {
+        OH_LOG_ERROR(LOG_APP, "Framebuffer allocation failed");
+        return FALSE;
+    }
+    fbWidth_.store(cl->width);
+    fbHeight_.store(cl->height);
 
-        fbWidth_ = cl->width;
-        fbHeight_ = cl->height;
+    // The continuous update area is the old desktop; cover the new one
+    if (cuActive_) {
+        sendEnableContinuousUpdates(true);
+    }
+    // The full request that follows a new size must not be held back
+    if (requestHeld_) {
+        requestHeld_ = false;
+        SetClient2Server(cl, rfbFramebufferUpdateRequest);
     }
 
-    if (resizeCallback_) {
+    // A reconnect to the same desktop keeps the renderer's layout and texture
+    if (resizeCallback_ && sizeChanged) {
         resizeCallback_(cl->width, cl->height);
     }
 
@@ -81,17 +235,154 @@ rfbBool VncClient::onResize(rfbClient* cl) {
 }
 
 void VncClient::onUpdate(rfbClient* cl, int x, int y, int w, int h) {
+    if (!updateInProgress_) {
+        updateInProgress_ = true;
+        updateStart_ = std::chrono::steady_clock::now();
+        updateReadNs_ = g_socketReadNs;
+    }
+    statPixels_ += static_cast<uint64_t>(w) * h;
+    updatePixels_ += static_cast<uint64_t>(w) * h;
+    updateDamage_.add(x, y, w, h);
+    updateRequestHold();
+}
+
+// Per rect, so the decision made at the last one is what libvncclient sees
+// when it sends the incremental request right after the update
+void VncClient::updateRequestHold() {
+    if (!updatesEnabled_ || cuSupported_) return;
+    int lead = frameLead_.load();
+    // This update is not published yet: it will be one more unconsumed frame
+    bool hold = lead > 0 && frames_.unconsumed() + 1 >= static_cast<uint64_t>(lead);
+    if (hold == requestHeld_) return;
+    requestHeld_ = hold;
+    if (hold) {
+        ClearClient2Server(client_, rfbFramebufferUpdateRequest);
+    } else {
+        SetClient2Server(client_, rfbFramebufferUpdateRequest);
+    }
+}
+
+// The Got* hooks do what libvncclient's defaults do, after waiting for queued
+// JPEG rects they overlap. libvncclient calls them before its own bounds check
+static bool rectInside(const rfbClient* cl, int x, int y, int w, int h) {
+    return x >= 0 && y >= 0 && w >= 0 && h >= 0 && x + w <= cl->width && y + h <= cl->height;
+}
+
+void VncClient::onFillRect(rfbClient* cl, int x, int y, int w, int h, uint32_t colour) {
+    if (!rectInside(cl, x, y, w, h)) return;
+    jpeg_.waitRect(x, y, w, h);
+    int bpp = cl->format.bitsPerPixel / 8;
+    size_t stride = static_cast<size_t>(cl->width) * bpp;
+    uint8_t* row = cl->frameBuffer + y * stride + static_cast<size_t>(x) * bpp;
+    for (int j = 0; j < h; j++, row += stride) {
+        for (int i = 0; i < w; i++) {
+            if (bpp == 4) {
+                memcpy(row + i * 4, &colour, 4);
+            } else {
+                uint16_t pixel = static_cast<uint16_t>(colour);
+                memcpy(row + i * 2, &pixel, 2);
+            }
+        }
+    }
+}
+
+void VncClient::onBitmap(rfbClient* cl, const uint8_t* buffer, int x, int y, int w, int h) {
+    if (!rectInside(cl, x, y, w, h)) return;
+    jpeg_.waitRect(x, y, w, h);
+    int bpp = cl->format.bitsPerPixel / 8;
+    size_t stride = static_cast<size_t>(cl->width) * bpp;
+    size_t rowBytes = static_cast<size_t>(w) * bpp;
+    uint8_t* row = cl->frameBuffer + y * stride + static_cast<size_t>(x) * bpp;
+    for (int j = 0; j < h; j++, row += stride, buffer += rowBytes) {
+        memcpy(row, buffer, rowBytes);
+    }
+}
+
+void VncClient::onCopyRect(rfbClient* cl, int srcX, int srcY, int w, int h, int dstX, int dstY) {
+    if (!rectInside(cl, srcX, srcY, w, h) || !rectInside(cl, dstX, dstY, w, h)) return;
+    jpeg_.waitRect(srcX, srcY, w, h);
+    jpeg_.waitRect(dstX, dstY, w, h);
+    int bpp = cl->format.bitsPerPixel / 8;
+    size_t stride = static_cast<size_t>(cl->width) * bpp;
+    size_t rowBytes = static_cast<size_t>(w) * bpp;
+    // Overlapping scroll down: copy bottom-up so no source row is overwritten first
+    bool upward = dstY > srcY;
+    for (int j = 0; j < h; j++) {
+        int row = upward ? h - 1 - j : j;
+        memmove(cl->frameBuffer + (dstY + row) * stride + static_cast<size_t>(dstX) * bpp,
+                cl->frameBuffer + (srcY + row) * stride + static_cast<size_t>(srcX) * bpp, rowBytes);
+    }
+}
+
+// Tight JPEG rect; libvncclient frees buffer when this returns
+rfbBool VncClient::onJpeg(rfbClient* cl, const uint8_t* buffer, int length, int x, int y, int w, int h) {
+    if (!rectInside(cl, x, y, w, h) || length <= 0) return FALSE;
+    int bpp = cl->format.bitsPerPixel / 8;
+    size_t stride = static_cast<size_t>(cl->width) * bpp;
+    if (jpeg_.submit(buffer, length, cl->frameBuffer, stride, x, y, w, h, bpp)) return TRUE;
+    // No workers (or they are stopping): decode here, and let libvncclient
+    // fail the rect like its own decoder would
+    if (!jpeg_.decodeNow(buffer, length, cl->frameBuffer, stride, x, y, w, h, bpp)) {
+        OH_LOG_WARN(LOG_APP, "JPEG rect %{public}dx%{public}d failed to decode", w, h);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+// End of a FramebufferUpdate: publish the back buffer as one complete frame,
+// then report its damage (after publish, so the renderer never sees damage
+// for a frame it cannot acquire yet)
+void VncClient::onFinishedUpdate(rfbClient* cl) {
+    jpeg_.waitAll();
+    if (updateInProgress_) {
+        updateInProgress_ = false;
+        statUpdates_++;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - updateStart_).count();
+        statUpdateNs_ += ns;
+        // The tuner judges decode cost; waiting for the link is its RTT's business
+        uint64_t readNs = g_socketReadNs - updateReadNs_;
+        if (tuner_.onUpdate(cl->sock, updatePixels_, ns > readNs ? ns - readNs : 0)) {
+            applyEncodingProfile();
+        }
+        updatePixels_ = 0;
+    }
+
+    // The reply comes back once the server has processed everything up to
+    // here, so unanswered fences count updates still queued towards us
+    if (cuActive_ && fenceSupported_ && sendFence(FENCE_REQUEST | FENCE_BLOCK_BEFORE, nullptr, 0)) {
+        fencesInFlight_++;
+        if (fencesInFlight_ >= FENCE_WINDOW) {
+            statFenceThrottled_++;
+        }
+        updateContinuousUpdates();
+    }
+    if (requestHeld_ && !requestDeferred_) {
+        requestDeferred_ = true;
+        deferredSince_ = std::chrono::steady_clock::now();
+        statRequestsDeferred_++;
+    }
+    if (updateDamage_.empty()) return;
+
+    uint8_t* back = frames_.publish(updateDamage_);
+    if (back) {
+        cl->frameBuffer = back;
+    }
+
     if (frameCallback_) {
-        VncFrameInfo info = {
-            .fbWidth = cl->width,
-            .fbHeight = cl->height,
-            .x = x,
-            .y = y,
-            .w = w,
-            .h = h
-        };
-        frameCallback_(info);
+        for (const DamageRect& r : updateDamage_) {
+            VncFrameInfo info = {
+                .fbWidth = cl->width,
+                .fbHeight = cl->height,
+                .x = r.x,
+                .y = r.y,
+                .w = r.w,
+                .h = r.h
+            };
+            frameCallback_(info);
+        }
     }
+    updateDamage_.clear();
 }
 
 // libvncclient calls GetPassword and frees the returned pointer with free()
@@ -104,22 +395,235 @@ char* VncClient::getPassword(rfbClient* cl) {
     return passwd;
 }
 
-bool VncClient::checkConnection() {
-    if (!client_ || client_->sock < 0) {
-        return false;
+// Messages libvncclient does not know. Returns FALSE for anything not ours
+rfbBool VncClient::onServerMessage(rfbClient* cl, rfbServerToClientMsg* msg) {
+    if (msg->type == MSG_END_OF_CONTINUOUS_UPDATES) {
+        // First one announces support; later ones acknowledge our disable
+        if (!cuSupported_) {
+            cuSupported_ = true;
+            OH_LOG_INFO(LOG_APP, "Server supports continuous updates");
+            updateContinuousUpdates();
+        }
+        return TRUE;
+    }
+    if (msg->type != MSG_FENCE) return FALSE;
+
+    char header[8];     // 3 padding, flags, length
+    char payload[FENCE_MAX_PAYLOAD];
+    if (!ReadFromRFBServer(cl, header, sizeof(header))) return FALSE;
+    uint32_t flags;
+    memcpy(&flags, header + 3, sizeof(flags));
+    flags = ntohl(flags);
+    uint8_t length = static_cast<uint8_t>(header[7]);
+    if (length > FENCE_MAX_PAYLOAD || !ReadFromRFBServer(cl, payload, length)) return FALSE;
+
+    if (flags & FENCE_REQUEST) {
+        // Messages are handled in order, so BlockBefore/BlockAfter hold as-is;
+        // SyncNext and unknown flags are cleared in the reply as unsupported
+        if (!fenceSupported_) {
+            fenceSupported_ = true;
+            OH_LOG_INFO(LOG_APP, "Server supports fences");
+        }
+        return sendFence(flags & (FENCE_BLOCK_BEFORE | FENCE_BLOCK_AFTER), payload, length);
     }
 
-    struct sockaddr_in peer_addr;
-    socklen_t addr_len = sizeof(peer_addr);
-    return getpeername(client_->sock, reinterpret_cast<struct sockaddr*>(&peer_addr), &addr_len) == 0;
+    // Reply to one of ours
+    if (fencesInFlight_ > 0) {
+        fencesInFlight_--;
+        updateContinuousUpdates();
+    }
+    return TRUE;
 }
 
-bool VncClient::connect(const char* address, int port, const char* passwd) {
-    // Clean up any existing connection (also clears callbacks)
-    disconnect();
+// Re-send SetPixelFormat (unchanged) + SetEncodings for the tuner's profile.
+// Rects already in flight keep decoding: libvncclient handles any encoding
+void VncClient::applyEncodingProfile() {
+    const EncodingProfile& p = tuner_.profile();
+    client_->appData.encodingsString = p.encodings;
+    client_->appData.compressLevel = p.compressLevel;
+    client_->appData.qualityLevel = tuner_.qualityLevel();
 
-    OH_LOG_INFO(LOG_APP, "Connect to %{public}s:%{public}d", address, port);
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    if (!SetFormatAndEncodings(client_)) {
+        OH_LOG_ERROR(LOG_APP, "SetEncodings for profile %{public}s failed", p.name);
+        return;
+    }
+    OH_LOG_INFO(LOG_APP, "Encoding profile -> %{public}s [%{public}s] compress=%{public}d "
+                "quality=%{public}d", p.name, p.encodings, p.compressLevel, tuner_.qualityLevel());
+}
+
+// ExtendedDesktopSize pseudo-rect: x = reason, y = status, w/h = new size,
+// followed by the screen layout. The first one (reason 0) announces support
+rfbBool VncClient::onServerEncoding(rfbClient* cl, rfbFramebufferUpdateRectHeader* rect) {
+    if (static_cast<int32_t>(rect->encoding) != ENCODING_EXT_DESKTOP_SIZE) return FALSE;
+
+    char header[4];     // number of screens, 3 padding
+    if (!ReadFromRFBServer(cl, header, sizeof(header))) return FALSE;
+    int screens = static_cast<uint8_t>(header[0]);
+    for (int i = 0; i < screens; i++) {
+        char screen[16];    // id, x, y, w, h, flags
+        if (!ReadFromRFBServer(cl, screen, sizeof(screen))) return FALSE;
+        if (i == 0) {
+            uint32_t id, flags;
+            memcpy(&id, screen, sizeof(id));
+            memcpy(&flags, screen + 12, sizeof(flags));
+            screenId_.store(ntohl(id));
+            screenFlags_.store(ntohl(flags));
+        }
+    }
+
+    if (!extDesktopSizeSupported_.exchange(true)) {
+        OH_LOG_INFO(LOG_APP, "Server supports ExtendedDesktopSize (screens=%{public}d)", screens);
+        // A size requested before we knew may be waiting in the writer
+        uint64_t one = 1;
+        write(inputEventFd_, &one, sizeof(one));
+    }
+    if (rect->r.y != 0) {
+        OH_LOG_WARN(LOG_APP, "SetDesktopSize rejected: status=%{public}d", rect->r.y);
+    }
+    if (rect->r.w == cl->width && rect->r.h == cl->height) return TRUE;
+
+    // Same as libvncclient does for NewFBSize
+    cl->width = rect->r.w;
+    cl->height = rect->r.h;
+    cl->updateRect.x = 0;
+    cl->updateRect.y = 0;
+    cl->updateRect.w = cl->width;
+    cl->updateRect.h = cl->height;
+    if (!cl->MallocFrameBuffer(cl)) return FALSE;
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return SendFramebufferUpdateRequest(cl, 0, 0, cl->width, cl->height, FALSE);
+}
+
+void VncClient::requestDesktopSize(int width, int height) {
+    if (width <= 0 || height <= 0) return;
+    {
+        std::lock_guard<std::mutex> lock(desktopSizeMutex_);
+        wantedWidth_ = std::min(width, MAX_DESKTOP_SIZE);
+        wantedHeight_ = std::min(height, MAX_DESKTOP_SIZE);
+        desktopSizeDue_ = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(DESKTOP_SIZE_DEBOUNCE_MS);
+        desktopSizePending_ = true;
+    }
+    if (writerRunning_.load(std::memory_order_acquire)) {
+        uint64_t one = 1;
+        write(inputEventFd_, &one, sizeof(one));
+    }
+}
+
+// Writer thread: ms until a pending SetDesktopSize is due, -1 if none (or
+// support is not known yet; learning it wakes the writer)
+int VncClient::desktopSizeDelayMs() {
+    if (!extDesktopSizeSupported_.load()) return -1;
+    std::lock_guard<std::mutex> lock(desktopSizeMutex_);
+    if (!desktopSizePending_) return -1;
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        desktopSizeDue_ - std::chrono::steady_clock::now()).count();
+    return wait > 0 ? static_cast<int>(wait) : 0;
+}
+
+// Writer thread, writeMutex_ held
+bool VncClient::sendDesktopSize() {
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(desktopSizeMutex_);
+        desktopSizePending_ = false;
+        width = wantedWidth_;
+        height = wantedHeight_;
+    }
+    if (width == fbWidth_.load() && height == fbHeight_.load()) return true;
+
+    OH_LOG_INFO(LOG_APP, "SetDesktopSize %{public}dx%{public}d", width, height);
+    uint8_t msg[24] = {};
+    uint16_t size[2] = {htons(static_cast<uint16_t>(width)), htons(static_cast<uint16_t>(height))};
+    uint32_t id = htonl(screenId_.load());
+    uint32_t flags = htonl(screenFlags_.load());
+    uint16_t area[4] = {0, 0, size[0], size[1]};
+    msg[0] = MSG_SET_DESKTOP_SIZE;
+    memcpy(msg + 2, size, sizeof(size));
+    msg[6] = 1;         // one screen covering the desktop
+    memcpy(msg + 8, &id, sizeof(id));
+    memcpy(msg + 12, area, sizeof(area));
+    memcpy(msg + 20, &flags, sizeof(flags));
+    return WriteToRFBServer(client_, reinterpret_cast<const char*>(msg), sizeof(msg));
+}
+
+// Stream while the app wants updates and the fence window has room. With
+// continuous updates on, libvncclient's per-update incremental request is
+// suppressed the same way setUpdatesEnabled(false) does it
+void VncClient::updateContinuousUpdates() {
+    bool want = cuSupported_ && updatesEnabled_ && fencesInFlight_ < FENCE_WINDOW;
+    if (cuSupported_) {
+        ClearClient2Server(client_, rfbFramebufferUpdateRequest);
+    }
+    if (want != cuActive_ && sendEnableContinuousUpdates(want)) {
+        cuActive_ = want;
+    }
+}
+
+bool VncClient::sendEnableContinuousUpdates(bool enable) {
+    uint8_t msg[10];
+    uint16_t area[4] = {0, 0, htons(static_cast<uint16_t>(client_->width)),
+                        htons(static_cast<uint16_t>(client_->height))};
+    msg[0] = MSG_ENABLE_CONTINUOUS_UPDATES;
+    msg[1] = enable ? 1 : 0;
+    memcpy(msg + 2, area, sizeof(area));
+
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return WriteToRFBServer(client_, reinterpret_cast<const char*>(msg), sizeof(msg));
+}
+
+bool VncClient::sendFence(uint32_t flags, const char* payload, uint8_t length) {
+    char msg[9 + FENCE_MAX_PAYLOAD] = {};
+    uint32_t netFlags = htonl(flags);
+    msg[0] = static_cast<char>(MSG_FENCE);
+    memcpy(msg + 4, &netFlags, sizeof(netFlags));
+    msg[8] = static_cast<char>(length);
+    if (length > 0) {
+        memcpy(msg + 9, payload, length);
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return WriteToRFBServer(client_, msg, 9 + length);
+}
+
+// Auto: loopback (the in-process QEMU) gets the server's native 32bpp layout,
+// bandwidth is free there; anything else gets the smaller RGB565
+bool VncClient::isLoopbackAddress(const char* address) {
+    struct in_addr v4;
+    struct in6_addr v6;
+    bool loopback = strcmp(address, "localhost") == 0;
+    if (inet_pton(AF_INET, address, &v4) == 1) {
+        loopback = (ntohl(v4.s_addr) >> 24) == 127;
+    } else if (inet_pton(AF_INET6, address, &v6) == 1) {
+        loopback = IN6_IS_ADDR_LOOPBACK(&v6);
+    }
+    return loopback;
+}
 
+VncPixelFormat VncClient::resolvePixelFormat(VncPixelFormat format, const char* address) {
+    if (format != VncPixelFormat::Auto) return format;
+    return isLoopbackAddress(address) ? VncPixelFormat::Bgrx8888 : VncPixelFormat::Rgb565;
+}
+
+void VncClient::logUpdateStats() {
+    if (statUpdates_ == 0) return;
+    double mpx = statPixels_ / 1e6;
+    OH_LOG_INFO(LOG_APP, "Update stats [%{public}s]: updates=%{public}llu pixels=%{public}.1fM "
+                "recv+decode avg=%{public}lluus per-Mpx=%{public}.0fus",
+                pixelFormatName(pixelFormat_),
+                static_cast<unsigned long long>(statUpdates_), mpx,
+                static_cast<unsigned long long>(statUpdateNs_ / statUpdates_ / 1000),
+                mpx > 0 ? statUpdateNs_ / 1000.0 / mpx : 0.0);
+    if (jpeg_.rects() > 0) {
+        OH_LOG_INFO(LOG_APP, "JPEG rects: %{public}llu failed=%{public}llu",
+                    static_cast<unsigned long long>(jpeg_.rects()),
+                    static_cast<unsigned long long>(jpeg_.failures()));
+    }
+}
+
+// Server and settings for openClient(), kept for reconnect()
+void VncClient::setTarget(const char* address, int port, const char* passwd, VncPixelFormat format) {
     // Redirect libvncserver logging to HiLog
     rfbClientLog = hishVncLog;
     rfbClientErr = hishVncErr;
@@ -127,7 +631,196 @@ bool VncClient::connect(const char* address, int port, const char* passwd) {
     strncpy(password_, passwd, 255);
     password_[255] = '\0';
 
-    client_ = rfbGetClient(8, 3, 2);  // 8 bits/sample, 3 samples, 2 bytes/pixel (RGB565)
+    pixelFormat_ = resolvePixelFormat(format, address);
+    address_ = address;
+    port_ = port;
+}
+
+bool VncClient::connect(const char* address, int port, const char* passwd, VncPixelFormat format,
+                        const std::atomic<bool>& cancel) {
+    // Clean up any existing connection (also clears callbacks)
+    disconnect();
+    OH_LOG_INFO(LOG_APP, "Connect to %{public}s:%{public}d", address, port);
+    setTarget(address, port, passwd, format);
+    // In-process QEMU: skip TCP (and the listening port) with a socketpair
+    return openClient(isLoopbackAddress(address) ? openLocalSocket(cancel) : RFB_INVALID_SOCKET, cancel);
+}
+
+// Handshake with address_/port_ over localSock (from openLocalSocket, taken
+// over) or else TCP, and start the per-connection threads; leaves frames_
+// alone so a reconnect keeps the last frame on screen
+bool VncClient::openClient(int localSock, const std::atomic<bool>& cancel) {
+    const char* address = address_.c_str();
+    int port = port_;
+    if (!createClient(address, port)) {
+        if (localSock != RFB_INVALID_SOCKET) close(localSock);
+        return false;
+    }
+
+    bool local = false;
+    if (localSock != RFB_INVALID_SOCKET) {
+        local = initConnection(localSock, cancel);
+        if (!local && !cancel.load()) {
+            OH_LOG_WARN(LOG_APP, "Local VNC handshake failed, falling back to TCP");
+            rfbClientCleanup(client_);   // also closes localSock
+            client_ = nullptr;
+            if (!createClient(address, port)) {
+                return false;
+            }
+        }
+    }
+
+    // Our own TCP socket rather than rfbInitClient's, so abortConnect() can
+    // reach the handshake
+    if (!local && (cancel.load() ||
+                   !initConnection(openTcpSocket(address, port, CONNECT_TIMEOUT_MS, cancel), cancel))) {
+        OH_LOG_ERROR(LOG_APP, "VNC handshake with %{public}s:%{public}d failed", address, port);
+        // rfbClientCleanup frees serverHost and other internal allocations,
+        // and closes the socket
+        rfbClientCleanup(client_);
+        client_ = nullptr;
+        return false;
+    }
+
+    connected_.store(true);
+    startWriter();
+    // Leave cores for the renderer and QEMU's vCPU threads
+    int workers = static_cast<int>(std::thread::hardware_concurrency()) / 2 - 1;
+    jpeg_.start(std::max(0, std::min(workers, MAX_JPEG_WORKERS)));
+    OH_LOG_INFO(LOG_APP, "Connected: %{public}dx%{public}d sock=%{public}d transport=%{public}s "
+                "format=%{public}s encodings=[%{public}s]",
+                client_->width, client_->height, client_->sock, local ? "socketpair" : "tcp",
+                pixelFormatName(pixelFormat_), client_->appData.encodingsString);
+    return true;
+}
+
+// Sleeps delayMs in short slices (so a cancel is noticed) and doubles it up to
+// CONNECT_RETRY_MAX_MS. False when cancelled or it would end past deadline
+bool VncClient::backoff(int& delayMs, std::chrono::steady_clock::time_point deadline,
+                        const std::atomic<bool>& cancel) {
+    auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+    if (cancel.load() || wake > deadline) return false;
+    while (!cancel.load() && std::chrono::steady_clock::now() < wake) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    delayMs = std::min(delayMs * 2, CONNECT_RETRY_MAX_MS);
+    return !cancel.load();
+}
+
+// True once a TCP connect to address:port succeeds within timeoutMs
+int VncClient::openTcpSocket(const char* address, int port, int timeoutMs,
+                             const std::atomic<bool>& cancel) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(address, service.c_str(), &hints, &res) != 0 || !res) return RFB_INVALID_SOCKET;
+
+    bool connected = false;
+    int sock = socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (sock >= 0) {
+        if (::connect(sock, res->ai_addr, res->ai_addrlen) == 0) {
+            connected = true;
+        } else if (errno == EINPROGRESS) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            connected = waitSocket(sock, POLLOUT, timeoutMs, cancel) &&
+                        getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0;
+        }
+    }
+    freeaddrinfo(res);
+    if (!connected) {
+        if (sock >= 0) close(sock);
+        return RFB_INVALID_SOCKET;
+    }
+
+    // libvncclient reads blocking; input latency wants no Nagle
+    int one = 1;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) & ~O_NONBLOCK);
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return sock;
+}
+
+bool VncClient::connectWhenReady(const char* address, int port, const char* passwd,
+                                 VncPixelFormat format, int timeoutMs, const std::atomic<bool>& cancel) {
+    disconnect();
+    OH_LOG_INFO(LOG_APP, "Connect to %{public}s:%{public}d when ready", address, port);
+    setTarget(address, port, passwd, format);
+    // The server is up once it answers; a failed handshake then is not retried
+    return openWhenReady(timeoutMs, false, cancel);
+}
+
+bool VncClient::reconnect(int timeoutMs, const std::atomic<bool>& cancel) {
+    {
+        std::lock_guard<std::mutex> lock(socketMutex_);
+        if (!client_) return false;
+        closeClient();
+    }
+    // The handshake's update request is the one full update we resume with; a
+    // pause still requested is applied again by the poll loop
+    return openWhenReady(timeoutMs, true, cancel);
+}
+
+// openClient() with address_/port_ once the server answers, retrying with
+// backoff until timeoutMs. Loopback tries the in-process hook first each round
+// and probes TCP only when that fails
+bool VncClient::openWhenReady(int timeoutMs, bool retryHandshake, const std::atomic<bool>& cancel) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    int delayMs = CONNECT_RETRY_MIN_MS;
+    bool loopback = isLoopbackAddress(address_.c_str());
+    for (int attempt = 1;; attempt++) {
+        int localSock = loopback ? openLocalSocket(cancel) : RFB_INVALID_SOCKET;
+        bool ready = localSock != RFB_INVALID_SOCKET;
+        if (!ready) {
+            int probe = openTcpSocket(address_.c_str(), port_, CONNECT_PROBE_TIMEOUT_MS, cancel);
+            if (probe != RFB_INVALID_SOCKET) {
+                close(probe);
+                ready = true;
+            }
+        }
+        if (ready && !cancel.load()) {
+            std::lock_guard<std::mutex> lock(socketMutex_);
+            if (openClient(localSock, cancel)) {
+                if (attempt > 1) {
+                    OH_LOG_INFO(LOG_APP, "VNC server ready after %{public}d attempts", attempt);
+                }
+                return true;
+            }
+            if (!retryHandshake) return false;
+        } else if (localSock != RFB_INVALID_SOCKET) {
+            close(localSock);
+        }
+        if (!backoff(delayMs, deadline, cancel)) {
+            OH_LOG_WARN(LOG_APP, "VNC server %{public}s:%{public}d not ready after %{public}d attempts",
+                        address_.c_str(), port_, attempt);
+            return false;
+        }
+    }
+}
+
+bool VncClient::waitFirstUpdate(int timeoutMs, const std::atomic<bool>& cancel) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!cancel.load()) {
+        std::lock_guard<std::mutex> lock(socketMutex_);
+        if (statUpdates_ > 0) return true;
+        if (!client_ || std::chrono::steady_clock::now() >= deadline) break;
+        int i = WaitForMessage(client_, 50);
+        if (i < 0 || (i > 0 && !HandleRFBServerMessage(client_))) {
+            OH_LOG_ERROR(LOG_APP, "Connection lost before the first update (errno=%{public}d)", errno);
+            return false;
+        }
+    }
+    if (cancel.load()) return false;
+    OH_LOG_WARN(LOG_APP, "No complete update within %{public}dms", timeoutMs);
+    return false;
+}
+
+// rfbGetClient + pixel format / encodings / callbacks, no connection yet
+bool VncClient::createClient(const char* address, int port) {
+    bool bgrx = pixelFormat_ == VncPixelFormat::Bgrx8888;
+
+    client_ = rfbGetClient(8, 3, bgrx ? 4 : 2);  // 8 bits/sample, 3 samples, 4 or 2 bytes/pixel
     if (!client_) {
         OH_LOG_ERROR(LOG_APP, "Failed to create VNC client");
         return false;
@@ -136,58 +829,182 @@ bool VncClient::connect(const char* address, int port, const char* passwd) {
     client_->serverHost = strdup(address);
     client_->serverPort = port;
 
-    // Configure RGB565 format
+    // Configure pixel format; the renderer picks the matching texture format
+    // from the frame's bytes per pixel
     client_->canHandleNewFBSize = TRUE;
     client_->MallocFrameBuffer = VncClient::onResize;
-    client_->format.depth = 16;
-    client_->format.bitsPerPixel = 16;
-    client_->format.redShift = 11;
-    client_->format.greenShift = 5;
-    client_->format.blueShift = 0;
-    client_->format.redMax = 0x1f;
-    client_->format.greenMax = 0x3f;
-    client_->format.blueMax = 0x1f;
-
-    // Compression
-    client_->appData.compressLevel = 5;
-    client_->appData.qualityLevel = 1;
-#ifdef LIBVNCSERVER_HAVE_LIBZ
-    client_->appData.encodingsString = "zrle ultra hextile zlib copyrect raw";
-#else
-    client_->appData.encodingsString = "ultra hextile copyrect raw";
-#endif
+    if (bgrx) {
+        // x8r8g8b8 little endian = B, G, R, X in memory (QEMU's pixman layout)
+        client_->format.depth = 24;
+        client_->format.bitsPerPixel = 32;
+        client_->format.redShift = 16;
+        client_->format.greenShift = 8;
+        client_->format.blueShift = 0;
+        client_->format.redMax = 0xff;
+        client_->format.greenMax = 0xff;
+        client_->format.blueMax = 0xff;
+    } else {
+        client_->format.depth = 16;
+        client_->format.bitsPerPixel = 16;
+        client_->format.redShift = 11;
+        client_->format.greenShift = 5;
+        client_->format.blueShift = 0;
+        client_->format.redMax = 0x1f;
+        client_->format.greenMax = 0x3f;
+        client_->format.blueMax = 0x1f;
+    }
+    client_->format.bigEndian = FALSE;
+
+    // Encodings + compression: raw on loopback, zrle elsewhere until the
+    // tuner has measured the link
+    tuner_.reset(isLoopbackAddress(address));
+    const EncodingProfile& profile = tuner_.profile();
+    client_->appData.encodingsString = profile.encodings;
+    client_->appData.compressLevel = profile.compressLevel;
+    client_->appData.qualityLevel = tuner_.qualityLevel();
+    client_->appData.enableJPEG = TRUE;
     // useRemoteCursor=FALSE: QEMU cursor pseudo-encodings may cause stream desync.
     // Standard vncviewer defaults to FALSE.
     client_->appData.useRemoteCursor = FALSE;
     client_->GetPassword = VncClient::getPassword;
     client_->GotFrameBufferUpdate = VncClient::onUpdate;
-    client_->connectTimeout = 5;
+    client_->FinishedFrameBufferUpdate = VncClient::onFinishedUpdate;
+    client_->GotFillRect = VncClient::onFillRect;
+    client_->GotBitmap = VncClient::onBitmap;
+    client_->GotCopyRect = VncClient::onCopyRect;
+    client_->GotJpeg = VncClient::onJpeg;
     // readTimeout=0 (infinite): non-zero values cause spurious ReadFromRFBServer
     // timeouts during ZRLE/zlib decode of large frames, killing the poll thread.
     client_->readTimeout = 0;
 
-    if (!rfbInitClient(client_, 0, nullptr)) {
-        OH_LOG_ERROR(LOG_APP, "rfbInitClient failed");
-        // rfbClientCleanup frees serverHost and other internal allocations
-        rfbClientCleanup(client_);
-        client_ = nullptr;
-        return false;
+    // Global list in libvncclient: register once, state is reset per connection
+    static bool extensionRegistered = false;
+    if (!extensionRegistered) {
+        g_extension.handleEncoding = VncClient::onServerEncoding;
+        g_extension.handleMessage = VncClient::onServerMessage;
+        rfbClientRegisterExtension(&g_extension);
+        extensionRegistered = true;
     }
+    updatesEnabled_ = true;
+    cuSupported_ = false;
+    cuActive_ = false;
+    fenceSupported_ = false;
+    fencesInFlight_ = 0;
+    statFenceThrottled_ = 0;
+    requestHeld_ = false;
+    requestDeferred_ = false;
+    statRequestsDeferred_ = 0;
+    statDeferTimeouts_ = 0;
+    // A wanted desktop size survives reconnects and is re-sent once known
+    extDesktopSizeSupported_.store(false);
 
-    connected_.store(true);
-    OH_LOG_INFO(LOG_APP, "Connected: %{public}dx%{public}d sock=%{public}d encodings=[%{public}s]",
-                client_->width, client_->height, client_->sock,
-                client_->appData.encodingsString);
     return true;
 }
 
+// One end of a socketpair becomes a VNC client of the in-process QEMU through
+// the libqemu hook, the only route (callers fall back to TCP). Returns the
+// other end once the server greeting is waiting on it, RFB_INVALID_SOCKET otherwise
+int VncClient::openLocalSocket(const std::atomic<bool>& cancel) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        OH_LOG_WARN(LOG_APP, "socketpair failed: errno=%{public}d", errno);
+        return RFB_INVALID_SOCKET;
+    }
+
+    // QEMU owns sv[1] once the hook accepted it, and closes it again when it
+    // has no VNC display. A libqemu without the hook gets TCP
+    auto addClient = reinterpret_cast<HishVncAddClientFn>(
+        DisplayBridge::findQemuSymbol(HISH_VNC_ADD_CLIENT_SYMBOL));
+    if (!addClient || addClient(sv[1]) != 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return RFB_INVALID_SOCKET;
+    }
+
+    // The server speaks first; a hangup means there was no display to take it
+    char greeting;
+    if (!waitSocket(sv[0], POLLIN, LOCAL_CONNECT_TIMEOUT_MS, cancel) ||
+        recv(sv[0], &greeting, 1, MSG_PEEK) != 1) {
+        OH_LOG_WARN(LOG_APP, "No VNC greeting on socketpair");
+        close(sv[0]);
+        return RFB_INVALID_SOCKET;
+    }
+    OH_LOG_INFO(LOG_APP, "VNC client socketpair attached");
+    return sv[0];
+}
+
+// What rfbInitClient does after connecting, for a socket we already have.
+// Takes ownership of sock (rfbClientCleanup closes it)
+bool VncClient::initConnection(int sock, const std::atomic<bool>& cancel) {
+    if (sock == RFB_INVALID_SOCKET) return false;
+    client_->sock = sock;
+    {
+        // abortConnect() runs after cancel is set: either it sees the socket
+        // here or we see the cancel
+        std::lock_guard<std::mutex> lock(handshakeMutex_);
+        if (cancel.load()) return false;
+        handshakeSock_ = sock;
+    }
+    bool ok = InitialiseRFBConnection(client_);
+    {
+        std::lock_guard<std::mutex> lock(handshakeMutex_);
+        handshakeSock_ = RFB_INVALID_SOCKET;
+    }
+    if (!ok || cancel.load()) return false;
+
+    client_->width = client_->si.framebufferWidth;
+    client_->height = client_->si.framebufferHeight;
+    if (!client_->MallocFrameBuffer(client_)) return false;
+    if (!SetFormatAndEncodings(client_)) return false;
+
+    client_->updateRect.x = 0;
+    client_->updateRect.y = 0;
+    client_->updateRect.w = client_->width;
+    client_->updateRect.h = client_->height;
+    return SendFramebufferUpdateRequest(client_, 0, 0, client_->width, client_->height, FALSE);
+}
+
+void VncClient::abortConnect() {
+    std::lock_guard<std::mutex> lock(handshakeMutex_);
+    if (handshakeSock_ != RFB_INVALID_SOCKET) {
+        shutdown(handshakeSock_, SHUT_RDWR);
+    }
+}
+
 void VncClient::disconnect() {
     // Clear callbacks first to prevent in-flight calls
     resizeCallback_ = nullptr;
     frameCallback_ = nullptr;
 
+    closeClient();
+
+    // Waits for the render thread to release its frame before freeing
+    frames_.reset();
+    fbWidth_.store(0);
+    fbHeight_.store(0);
+
+    // The next session decides again (DisplayBridge may not attach to it);
+    // surfaceAttached_ follows the renderer, which outlives sessions
+    updatesRequested_.store(true);
+    pageVisible_.store(true);
+}
+
+// Stop the per-connection threads and drop the socket and rfbClient; the
+// decoded frames and callbacks stay. Caller serializes with the poll thread
+void VncClient::closeClient() {
     if (client_) {
         connected_.store(false);
+        stopWriter();
+        jpeg_.stop();
+        logUpdateStats();
+        if (cuSupported_) {
+            OH_LOG_INFO(LOG_APP, "Continuous updates: fences=%{public}s throttled=%{public}llu",
+                        fenceSupported_ ? "yes" : "no", static_cast<unsigned long long>(statFenceThrottled_));
+        } else if (statRequestsDeferred_ > 0) {
+            OH_LOG_INFO(LOG_APP, "Flow control: lead=%{public}d deferred=%{public}llu timeouts=%{public}llu",
+                        frameLead_.load(), static_cast<unsigned long long>(statRequestsDeferred_),
+                        static_cast<unsigned long long>(statDeferTimeouts_));
+        }
 
         if (client_->sock >= 0) {
             rfbCloseSocket(client_->sock);
@@ -196,31 +1013,152 @@ void VncClient::disconnect() {
         client_ = nullptr;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(fbMutex_);
-        delete[] frameBuffer_;
-        frameBuffer_ = nullptr;
-        fbWidth_ = 0;
-        fbHeight_ = 0;
-    }
+    // A partly received update is abandoned; the next one is a full update
+    updateDamage_.clear();
+    updateInProgress_ = false;
+    updatePixels_ = 0;
+    statUpdates_ = 0;
+    statPixels_ = 0;
+    statUpdateNs_ = 0;
 }
 
+// Only the atomic: client_ belongs to the poll thread. No syscall per input
+// event either, a dead peer shows up as a read error on the poll thread
 bool VncClient::isConnected() {
-    return connected_.load() && checkConnection();
+    return connected_.load();
 }
 
 void VncClient::sendMouseEvent(int x, int y, int buttonMask) {
-    std::lock_guard<std::mutex> lock(socketMutex_);
-    if (checkConnection()) {
-        SendPointerEvent(client_, x, y, buttonMask);
-    }
+    InputEvent ev = {};
+    ev.type = InputEvent::Pointer;
+    ev.x = x;
+    ev.y = y;
+    ev.buttonMask = buttonMask;
+    queueInput(ev);
 }
 
 void VncClient::sendKeyEvent(uint32_t key, bool down) {
-    std::lock_guard<std::mutex> lock(socketMutex_);
-    if (checkConnection()) {
-        SendKeyEvent(client_, key, down ? TRUE : FALSE);
+    InputEvent ev = {};
+    ev.type = InputEvent::Key;
+    ev.key = key;
+    ev.down = down;
+    queueInput(ev);
+}
+
+// Dekker-style handshake with stopWriter(): both sides use seq_cst
+void VncClient::queueInput(const InputEvent& ev) {
+    inputProducers_.fetch_add(1);
+    if (writerRunning_.load()) {
+        if (inputQueue_.push(ev)) {
+            uint64_t one = 1;
+            write(inputEventFd_, &one, sizeof(one));
+        } else {
+            // Writer stuck on a full socket buffer; losing input beats blocking JS
+            statInputDropped_++;
+        }
     }
+    inputProducers_.fetch_sub(1);
+}
+
+void VncClient::startWriter() {
+    if (inputEventFd_ < 0) {
+        OH_LOG_ERROR(LOG_APP, "No input eventfd, input disabled");
+        return;
+    }
+    statInputDropped_ = 0;
+    statMotionCoalesced_ = 0;
+    writerRunning_.store(true, std::memory_order_release);
+    writerThread_ = std::thread(writerLoop);
+}
+
+void VncClient::stopWriter() {
+    if (!writerRunning_.exchange(false)) return;
+    uint64_t one = 1;
+    write(inputEventFd_, &one, sizeof(one));
+    if (writerThread_.joinable()) {
+        writerThread_.join();
+    }
+    // Discard whatever was queued for the old connection, including pushes
+    // still in flight, and the wakeups that came with them
+    while (inputProducers_.load() > 0) {
+        std::this_thread::yield();
+    }
+    InputEvent ev;
+    while (inputQueue_.pop(ev)) {
+    }
+    uint64_t count;
+    read(inputEventFd_, &count, sizeof(count));
+    if (statInputDropped_ > 0) {
+        OH_LOG_WARN(LOG_APP, "Input events dropped (queue full): %{public}llu",
+                    static_cast<unsigned long long>(statInputDropped_.load()));
+    }
+    OH_LOG_INFO(LOG_APP, "Pointer motion coalesced: %{public}llu",
+                static_cast<unsigned long long>(statMotionCoalesced_));
+}
+
+// Sends queued input as soon as it arrives, regardless of what the poll
+// thread is decoding. Exits on stop or when the server hangs up
+void VncClient::writerLoop() {
+    OH_LOG_INFO(LOG_APP, "VNC input writer started");
+    struct pollfd fds[2] = {
+        {inputEventFd_, POLLIN, 0},
+        {client_->sock, 0, 0},      // POLLHUP/POLLERR only
+    };
+    const auto interval = std::chrono::milliseconds(MOTION_INTERVAL_MS);
+    auto lastMotion = std::chrono::steady_clock::now() - interval;
+    MotionCoalescer coalescer;
+    bool ok = true;
+
+    while (ok && writerRunning_.load(std::memory_order_acquire)) {
+        int timeoutMs = -1;
+        if (coalescer.pending()) {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                lastMotion + interval - std::chrono::steady_clock::now()).count();
+            timeoutMs = wait > 0 ? static_cast<int>(wait) : 0;
+        }
+        int resizeMs = desktopSizeDelayMs();
+        if (resizeMs >= 0 && (timeoutMs < 0 || resizeMs < timeoutMs)) {
+            timeoutMs = resizeMs;
+        }
+        int ready = poll(fds, 2, timeoutMs);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents & (POLLHUP | POLLERR | POLLNVAL)) break;
+
+        if (fds[0].revents & POLLIN) {
+            uint64_t count;
+            read(inputEventFd_, &count, sizeof(count));
+        }
+
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        InputEvent ev;
+        while (ok && writerRunning_.load(std::memory_order_acquire) && inputQueue_.pop(ev)) {
+            InputEvent out[2];
+            int n = coalescer.feed(ev, out);
+            for (int i = 0; ok && i < n; i++) {
+                if (out[i].type == InputEvent::Pointer) {
+                    ok = SendPointerEvent(client_, out[i].x, out[i].y, out[i].buttonMask);
+                } else {
+                    ok = SendKeyEvent(client_, out[i].key, out[i].down ? TRUE : FALSE);
+                }
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        InputEvent motion;
+        if (ok && now - lastMotion >= interval && coalescer.flush(motion)) {
+            ok = SendPointerEvent(client_, motion.x, motion.y, motion.buttonMask);
+            lastMotion = now;
+        }
+
+        if (ok && desktopSizeDelayMs() == 0) {
+            ok = sendDesktopSize();
+        }
+    }
+    statMotionCoalesced_ = coalescer.coalesced();
+    OH_LOG_INFO(LOG_APP, "VNC input writer stopped");
 }
 
 void VncClient::setResizeCallback(VncResizeCallback cb) {
@@ -231,16 +1169,85 @@ void VncClient::setFrameCallback(VncFrameCallback cb) {
     frameCallback_ = cb;
 }
 
-uint8_t* VncClient::getFrameBuffer() {
-    return frameBuffer_;
+void VncClient::setUpdatesEnabled(bool enabled) {
+    updatesRequested_.store(enabled);
+}
+
+void VncClient::setPageVisible(bool visible) {
+    pageVisible_.store(visible);
+}
+
+void VncClient::setSurfaceAttached(bool attached) {
+    surfaceAttached_.store(attached);
+}
+
+void VncClient::applyUpdateState() {
+    if (!client_ || !connected_.load()) return;
+    bool enabled = updatesRequested_.load() && pageVisible_.load() && surfaceAttached_.load();
+    if (enabled == updatesEnabled_) {
+        if (requestDeferred_) releaseDeferredRequest();
+        return;
+    }
+
+    // libvncclient skips FramebufferUpdateRequests (including the incremental
+    // one after each update) for messages the client does not "support".
+    // Pausing drops a held-back request, resuming asks for everything anyway
+    updatesEnabled_ = enabled;
+    requestHeld_ = false;
+    requestDeferred_ = false;
+    if (!enabled) {
+        ClearClient2Server(client_, rfbFramebufferUpdateRequest);
+        updateContinuousUpdates();
+        OH_LOG_INFO(LOG_APP, "Framebuffer updates paused");
+        return;
+    }
+    SetClient2Server(client_, rfbFramebufferUpdateRequest);
+    {
+        std::lock_guard<std::mutex> writeLock(writeMutex_);
+        SendFramebufferUpdateRequest(client_, 0, 0, client_->width, client_->height, FALSE);
+    }
+    updateContinuousUpdates();
+    OH_LOG_INFO(LOG_APP, "Framebuffer updates resumed");
+}
+
+void VncClient::setFrameLead(int frames) {
+    frameLead_.store(std::max(frames, 0));
+    OH_LOG_INFO(LOG_APP, "Frame lead: %{public}d", std::max(frames, 0));
+}
+
+void VncClient::releaseDeferredRequest() {
+    int lead = frameLead_.load();
+    bool behind = lead > 0 && frames_.unconsumed() >= static_cast<uint64_t>(lead);
+    if (behind) {
+        if (std::chrono::steady_clock::now() - deferredSince_ < std::chrono::milliseconds(FLOW_MAX_DEFER_MS)) {
+            return;
+        }
+        statDeferTimeouts_++;
+    }
+    requestDeferred_ = false;
+    requestHeld_ = false;
+    SetClient2Server(client_, rfbFramebufferUpdateRequest);
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    SendIncrementalFramebufferUpdateRequest(client_);
+}
+
+void VncClient::waitForRenderer() {
+    if (!requestDeferred_) return;
+    int lead = frameLead_.load();
+    if (lead <= 0 || frames_.unconsumed() < static_cast<uint64_t>(lead)) return;
+    auto remaining = std::chrono::milliseconds(FLOW_MAX_DEFER_MS) - (std::chrono::steady_clock::now() - deferredSince_);
+    int ms = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+    if (ms > 0) {
+        frames_.waitConsumed(frames_.published() - lead + 1, ms);
+    }
 }
 
 int VncClient::getFrameWidth() {
-    return fbWidth_;
+    return fbWidth_.load();
 }
 
 int VncClient::getFrameHeight() {
-    return fbHeight_;
+    return fbHeight_.load();
 }
 
 rfbClient* VncClient::getClient() {
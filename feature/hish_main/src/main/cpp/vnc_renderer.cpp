@@ -1,18 +1,27 @@
 //
 // VNC OpenGL ES3 Renderer Implementation for HiSH
-// Renders RGB565 VNC framebuffer via XComponent + EGL + OpenGL ES
+// Renders the RGB565 or BGRX8888 VNC framebuffer via XComponent + EGL + OpenGL ES
 //
 // Threading:
 //   - Render thread owns the EGL context and performs all GL operations.
 //     It sleeps on a condition variable and wakes when dirty or resized.
 //   - Poll thread calls markDirty() which wakes the render thread.
+//   - Frames are read via VncClient::acquireFrame() (lock-free triple buffer),
+//     or straight from QEMU's surface while the DisplayBridge is attached.
 //   - JS thread calls init/shutdown/resize — no GL calls except during init().
 //
 
 #include "include/vnc_renderer.hpp"
 #include "include/vnc_client.hpp"
+#include "include/display_bridge.hpp"
 #include <native_window/external_window.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <functional>
+#include <string>
 #include <vector>
 #include "hilog/log.h"
 
@@ -21,36 +30,42 @@
 #define LOG_DOMAIN 0x3303
 #define LOG_TAG "VNCRender"
 
-// Vertex shader: fullscreen quad in NDC (GLES 3.0)
+// Vertex shader: unit quad placed at u_dstRect (NDC x, y, w, h), sampling
+// u_srcRect (texture coords x, y, w, h) of the current tile (GLES 3.0)
 static const char* VERTEX_SHADER_ES3 = R"(#version 300 es
 layout(location = 0) in vec2 a_pos;
-layout(location = 1) in vec2 a_texCoord;
+uniform vec4 u_dstRect;
+uniform vec4 u_srcRect;
 out vec2 v_texCoord;
 void main() {
-    gl_Position = vec4(a_pos, 0.0, 1.0);
-    v_texCoord = a_texCoord;
+    gl_Position = vec4(u_dstRect.xy + a_pos * u_dstRect.zw, 0.0, 1.0);
+    v_texCoord = u_srcRect.xy + a_pos * u_srcRect.zw;
 }
 )";
 
-// Fragment shader: sample RGB565 texture (GLES 3.0)
+// Fragment shader: sample the tile texture; u_swizzle = 1.0 swaps red and
+// blue for BGRX8888 data uploaded as RGBA (X is not alpha) (GLES 3.0)
 static const char* FRAGMENT_SHADER_ES3 = R"(#version 300 es
 precision mediump float;
 in vec2 v_texCoord;
 out vec4 fragColor;
 uniform sampler2D u_tex;
+uniform float u_swizzle;
 void main() {
-    fragColor = texture(u_tex, v_texCoord);
+    vec3 c = texture(u_tex, v_texCoord).rgb;
+    fragColor = vec4(mix(c, c.bgr, u_swizzle), 1.0);
 }
 )";
 
 // Vertex shader (GLES 2.0 fallback)
 static const char* VERTEX_SHADER_ES2 = R"(#version 100 es
 attribute vec2 a_pos;
-attribute vec2 a_texCoord;
+uniform vec4 u_dstRect;
+uniform vec4 u_srcRect;
 varying vec2 v_texCoord;
 void main() {
-    gl_Position = vec4(a_pos, 0.0, 1.0);
-    v_texCoord = a_texCoord;
+    gl_Position = vec4(u_dstRect.xy + a_pos * u_dstRect.zw, 0.0, 1.0);
+    v_texCoord = u_srcRect.xy + a_pos * u_srcRect.zw;
 }
 )";
 
@@ -59,8 +74,10 @@ static const char* FRAGMENT_SHADER_ES2 = R"(#version 100 es
 precision mediump float;
 varying vec2 v_texCoord;
 uniform sampler2D u_tex;
+uniform float u_swizzle;
 void main() {
-    gl_FragColor = texture2D(u_tex, v_texCoord);
+    vec3 c = texture2D(u_tex, v_texCoord).rgb;
+    gl_FragColor = vec4(mix(c, c.bgr, u_swizzle), 1.0);
 }
 )";
 
@@ -74,11 +91,50 @@ OHNativeWindow* VncRenderer::nativeWindow_ = nullptr;
 GLuint VncRenderer::shaderProgram_ = 0;
 GLuint VncRenderer::vao_ = 0;
 GLuint VncRenderer::vbo_ = 0;
-GLuint VncRenderer::textureId_ = 0;
+bool VncRenderer::isGLES3_ = false;
+std::string VncRenderer::programCacheDir_;
+bool VncRenderer::frameFromBridge_ = false;
+
+std::vector<VncRenderer::Tile> VncRenderer::tiles_;
+int VncRenderer::tileSize_ = VncRenderer::TILE_SIZE;
+int VncRenderer::texBytesPerPixel_ = 2;
+GLenum VncRenderer::texFormat_ = GL_RGB;
+GLenum VncRenderer::texType_ = GL_UNSIGNED_SHORT_5_6_5;
+std::vector<VncRenderer::TileUpload> VncRenderer::uploads_;
+std::vector<uint8_t> VncRenderer::uploadScratch_;
+
+GLuint VncRenderer::pbos_[PBO_COUNT] = {};
+GLsync VncRenderer::pboFences_[PBO_COUNT] = {};
+size_t VncRenderer::pboCapacity_[PBO_COUNT] = {};
+int VncRenderer::pboIndex_ = 0;
 
 GLint VncRenderer::posLoc_ = -1;
-GLint VncRenderer::texCoordLoc_ = -1;
 GLint VncRenderer::texLoc_ = -1;
+GLint VncRenderer::dstRectLoc_ = -1;
+GLint VncRenderer::srcRectLoc_ = -1;
+GLint VncRenderer::swizzleLoc_ = -1;
+
+uint64_t VncRenderer::statUploadBatches_ = 0;
+uint64_t VncRenderer::statUploadPixels_ = 0;
+uint64_t VncRenderer::statUploadNs_ = 0;
+
+RenderStatsRing VncRenderer::stats_;
+uint32_t VncRenderer::frameUploadBytes_ = 0;
+uint32_t VncRenderer::frameUploadRects_ = 0;
+uint32_t VncRenderer::frameCoalesced_ = 0;
+uint64_t VncRenderer::lastFrameSeq_ = 0;
+
+PFNGLGENQUERIESEXTPROC VncRenderer::genQueries_ = nullptr;
+PFNGLDELETEQUERIESEXTPROC VncRenderer::deleteQueries_ = nullptr;
+PFNGLBEGINQUERYEXTPROC VncRenderer::beginQuery_ = nullptr;
+PFNGLENDQUERYEXTPROC VncRenderer::endQuery_ = nullptr;
+PFNGLGETQUERYOBJECTUIVEXTPROC VncRenderer::getQueryObjectuiv_ = nullptr;
+PFNGLGETQUERYOBJECTUI64VEXTPROC VncRenderer::getQueryObjectui64v_ = nullptr;
+GLuint VncRenderer::gpuQueries_[GPU_QUERY_COUNT] = {};
+bool VncRenderer::gpuQueryPending_[GPU_QUERY_COUNT] = {};
+int VncRenderer::gpuQueryIndex_ = 0;
+bool VncRenderer::gpuQueryActive_ = false;
+uint32_t VncRenderer::lastGpuUs_ = 0;
 
 int VncRenderer::vncWidth_ = 0;
 int VncRenderer::vncHeight_ = 0;
@@ -86,18 +142,38 @@ int VncRenderer::surfaceWidth_ = 0;
 int VncRenderer::surfaceHeight_ = 0;
 
 std::atomic<bool> VncRenderer::dirty_(false);
-int VncRenderer::dirtyX_ = 0;
-int VncRenderer::dirtyY_ = 0;
-int VncRenderer::dirtyW_ = 0;
-int VncRenderer::dirtyH_ = 0;
+DamageRegion VncRenderer::dirtyRegion_;
 std::mutex VncRenderer::dirtyMutex_;
+VncRenderer::ViewTransform VncRenderer::view_ = {1.0f, 0.0f, 0.0f};
+bool VncRenderer::viewChanged_ = false;
+
+PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC VncRenderer::swapWithDamage_ = nullptr;
+PFNEGLSETDAMAGEREGIONKHRPROC VncRenderer::setDamageRegion_ = nullptr;
+bool VncRenderer::hasBufferAge_ = false;
+DamageRegion VncRenderer::screenHistory_[DAMAGE_HISTORY];
+int VncRenderer::historyCount_ = 0;
 
 std::thread VncRenderer::renderThread_;
 std::atomic<bool> VncRenderer::renderRunning_(false);
 std::mutex VncRenderer::renderWakeMutex_;
 std::condition_variable VncRenderer::renderWakeCv_;
 std::atomic<bool> VncRenderer::surfaceResized_(false);
+std::atomic<OH_NativeVSync*> VncRenderer::vsync_(nullptr);
+std::atomic<bool> VncRenderer::vsyncPaced_(false);
+std::atomic<bool> VncRenderer::vsyncRequested_(false);
+std::atomic<bool> VncRenderer::vsyncTick_(false);
+std::atomic<int> VncRenderer::frameRateCap_(60);
+long long VncRenderer::vsyncPeriodNs_ = 0;
 std::atomic<bool> VncRenderer::initialized_(false);
+std::atomic<bool> VncRenderer::headless_(false);
+std::mutex VncRenderer::lifecycleMutex_;
+
+VncRenderer::CaptureRequest* VncRenderer::captureRequest_ = nullptr;
+std::condition_variable VncRenderer::captureDoneCv_;
+GLuint VncRenderer::captureFbo_ = 0;
+GLuint VncRenderer::captureTex_ = 0;
+int VncRenderer::captureWidth_ = 0;
+int VncRenderer::captureHeight_ = 0;
 
 // ---- Helper: compile a GL shader ----
 static GLuint compileShader(GLenum type, const char* source) {
@@ -147,6 +223,84 @@ static void calcViewport(int surfaceW, int surfaceH, int vncW, int vncH,
     }
 }
 
+// ---- Helper: framebuffer -> surface pixel mapping for the current view ----
+// screen = origin + fb * scale, drawn only inside clip (the letterbox area)
+struct ScreenMapping {
+    float originX;
+    float originY;
+    float scale;
+    DamageRect clip;
+};
+
+static ScreenMapping calcMapping(int surfaceW, int surfaceH, int vncW, int vncH,
+                                 float zoom, float panX, float panY) {
+    int vpX, vpY, vpW, vpH;
+    calcViewport(surfaceW, surfaceH, vncW, vncH, vpX, vpY, vpW, vpH);
+
+    ScreenMapping m;
+    m.scale = static_cast<float>(vpW) / vncW * zoom;
+    // Keep the visible part of the desktop inside the framebuffer
+    float maxPanX = vncW - vncW / zoom;
+    float maxPanY = vncH - vncH / zoom;
+    panX = panX < 0.0f ? 0.0f : (panX > maxPanX ? maxPanX : panX);
+    panY = panY < 0.0f ? 0.0f : (panY > maxPanY ? maxPanY : panY);
+    m.originX = vpX - panX * m.scale;
+    m.originY = vpY - panY * m.scale;
+    m.clip = DamageRect{vpX, vpY, vpW, vpH};
+    return m;
+}
+
+// ---- Helper: map a framebuffer rect to surface pixels (top-left origin) ----
+// Grown by one pixel on each side: GL_LINEAR sampling bleeds into neighbours.
+static DamageRect fbRectToScreen(const DamageRect& r, const ScreenMapping& m) {
+    int x1 = static_cast<int>(floorf(m.originX + r.x * m.scale)) - 1;
+    int y1 = static_cast<int>(floorf(m.originY + r.y * m.scale)) - 1;
+    int x2 = static_cast<int>(ceilf(m.originX + (r.x + r.w) * m.scale)) + 1;
+    int y2 = static_cast<int>(ceilf(m.originY + (r.y + r.h) * m.scale)) + 1;
+    return DamageRect{x1, y1, x2 - x1, y2 - y1}.intersection(m.clip);
+}
+
+// ---- Helper: framebuffer area shown on screen (inverse of fbRectToScreen) ----
+static DamageRect visibleFbRect(const ScreenMapping& m, int vncW, int vncH) {
+    if (m.scale <= 0.0f) return DamageRect{0, 0, vncW, vncH};  // surface size not known yet
+    int x1 = static_cast<int>(floorf((m.clip.x - m.originX) / m.scale)) - 1;
+    int y1 = static_cast<int>(floorf((m.clip.y - m.originY) / m.scale)) - 1;
+    int x2 = static_cast<int>(ceilf((m.clip.x + m.clip.w - m.originX) / m.scale)) + 1;
+    int y2 = static_cast<int>(ceilf((m.clip.y + m.clip.h - m.originY) / m.scale)) + 1;
+    return DamageRect{x1, y1, x2 - x1, y2 - y1}.intersection(DamageRect{0, 0, vncW, vncH});
+}
+
+// ---- Helper: damage rects as EGL wants them (x, y, w, h; bottom-left origin) ----
+static int toEglRects(const DamageRegion& region, int surfaceH, EGLint* out) {
+    int n = 0;
+    for (const DamageRect& r : region) {
+        out[n * 4 + 0] = r.x;
+        out[n * 4 + 1] = surfaceH - (r.y + r.h);
+        out[n * 4 + 2] = r.w;
+        out[n * 4 + 3] = r.h;
+        n++;
+    }
+    return n;
+}
+
+// ---- Helper: GLES 3.x context, falling back to GLES 2.0 ----
+static EGLContext createGlesContext(EGLDisplay display, EGLConfig config) {
+    const EGLint contextAttribs3[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 3,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs3);
+    if (context == nullptr) {
+        OH_LOG_WARN(LOG_APP, "GLES 3.x context failed (err=%{public}d), trying GLES 2.0", eglGetError());
+        const EGLint contextAttribs2[] = {
+            EGL_CONTEXT_CLIENT_VERSION, 2,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs2);
+    }
+    return context;
+}
+
 bool VncRenderer::initEGL(int64_t surfaceId) {
     OH_LOG_INFO(LOG_APP, "initEGL: surfaceId=%{public}lld", static_cast<long long>(surfaceId));
 
@@ -172,8 +326,10 @@ bool VncRenderer::initEGL(int64_t surfaceId) {
     }
     OH_LOG_INFO(LOG_APP, "EGL %{public}d.%{public}d", majorVersion, minorVersion);
 
-    const EGLint configAttribs[] = {
-        EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+    // Prefer configs that can also back a pbuffer, so the context can stay
+    // alive (offscreen) while the window is gone; window-only as a fallback
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT | EGL_PBUFFER_BIT,
         EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT | EGL_OPENGL_ES3_BIT,
         EGL_RED_SIZE, 8,
         EGL_GREEN_SIZE, 8,
@@ -184,6 +340,10 @@ bool VncRenderer::initEGL(int64_t surfaceId) {
 
     EGLint numConfigs = 0;
     if (!eglChooseConfig(eglDisplay_, configAttribs, nullptr, 0, &numConfigs) || numConfigs < 1) {
+        configAttribs[1] = EGL_WINDOW_BIT;
+        numConfigs = 0;
+    }
+    if (numConfigs < 1 && (!eglChooseConfig(eglDisplay_, configAttribs, nullptr, 0, &numConfigs) || numConfigs < 1)) {
         OH_LOG_ERROR(LOG_APP, "No EGL configs found: err=%{public}d", eglGetError());
         eglTerminate(eglDisplay_);
         eglDisplay_ = EGL_NO_DISPLAY;
@@ -237,19 +397,7 @@ bool VncRenderer::initEGL(int64_t surfaceId) {
     }
 
     // Try GLES 3.x first, fallback to GLES 2.0
-    const EGLint contextAttribs3[] = {
-        EGL_CONTEXT_CLIENT_VERSION, 3,
-        EGL_NONE
-    };
-    eglContext_ = eglCreateContext(eglDisplay_, eglConfig_, EGL_NO_CONTEXT, contextAttribs3);
-    if (eglContext_ == nullptr) {
-        OH_LOG_WARN(LOG_APP, "GLES 3.x context failed (err=%{public}d), trying GLES 2.0", eglGetError());
-        const EGLint contextAttribs2[] = {
-            EGL_CONTEXT_CLIENT_VERSION, 2,
-            EGL_NONE
-        };
-        eglContext_ = eglCreateContext(eglDisplay_, eglConfig_, EGL_NO_CONTEXT, contextAttribs2);
-    }
+    eglContext_ = createGlesContext(eglDisplay_, eglConfig_);
     if (eglContext_ == nullptr) {
         OH_LOG_ERROR(LOG_APP, "Failed to create EGL context: err=%{public}d", eglGetError());
         eglDestroySurface(eglDisplay_, eglSurface_);
@@ -291,76 +439,404 @@ bool VncRenderer::initEGL(int64_t surfaceId) {
     return true;
 }
 
-bool VncRenderer::createShaders() {
-    const char* glVersionStr = reinterpret_cast<const char*>(glGetString(GL_VERSION));
-    bool isGLES3 = false;
-    if (glVersionStr) {
-        int major = 0;
-        if (sscanf(glVersionStr, "OpenGL ES %d.", &major) == 1) {
-            isGLES3 = (major >= 3);
+// Something for the context to be current on without a window: a small
+// pbuffer, or no surface at all with EGL_KHR_surfaceless_context. Offscreen
+// rendering goes to FBOs either way.
+bool VncRenderer::createOffscreenSurface() {
+    EGLint surfaceType = 0;
+    eglGetConfigAttrib(eglDisplay_, eglConfig_, EGL_SURFACE_TYPE, &surfaceType);
+    if (surfaceType & EGL_PBUFFER_BIT) {
+        const EGLint pbufferAttribs[] = {
+            EGL_WIDTH, 16,
+            EGL_HEIGHT, 16,
+            EGL_NONE
+        };
+        eglSurface_ = eglCreatePbufferSurface(eglDisplay_, eglConfig_, pbufferAttribs);
+        if (eglSurface_ != nullptr) return true;
+        OH_LOG_WARN(LOG_APP, "eglCreatePbufferSurface failed: err=%{public}d", eglGetError());
+    }
+    eglSurface_ = nullptr;
+    const char* ext = eglQueryString(eglDisplay_, EGL_EXTENSIONS);
+    return ext && strstr(ext, "EGL_KHR_surfaceless_context") != nullptr;
+}
+
+// New native window + window surface for the existing display/config/context
+bool VncRenderer::attachWindow(int64_t surfaceId) {
+    EGLint surfaceType = 0;
+    eglGetConfigAttrib(eglDisplay_, eglConfig_, EGL_SURFACE_TYPE, &surfaceType);
+    if (!(surfaceType & EGL_WINDOW_BIT)) return false;
+
+    OHNativeWindow* nativeWindow = nullptr;
+    int ret = OH_NativeWindow_CreateNativeWindowFromSurfaceId(surfaceId, &nativeWindow);
+    if (ret != 0 || nativeWindow == nullptr) {
+        OH_LOG_ERROR(LOG_APP, "Failed to create native window: ret=%{public}d", ret);
+        return false;
+    }
+    EGLSurface surface = eglCreateWindowSurface(eglDisplay_, eglConfig_, (EGLNativeWindowType)nativeWindow, nullptr);
+    if (surface == nullptr || !eglMakeCurrent(eglDisplay_, surface, surface, eglContext_)) {
+        OH_LOG_WARN(LOG_APP, "Reattach to new window failed: err=%{public}d", eglGetError());
+        if (surface != nullptr) eglDestroySurface(eglDisplay_, surface);
+        OH_NativeWindow_DestroyNativeWindow(nativeWindow);
+        return false;
+    }
+
+    eglSurface_ = surface;
+    nativeWindow_ = nativeWindow;
+    EGLint eglWidth = 0, eglHeight = 0;
+    eglQuerySurface(eglDisplay_, eglSurface_, EGL_WIDTH, &eglWidth);
+    eglQuerySurface(eglDisplay_, eglSurface_, EGL_HEIGHT, &eglHeight);
+    surfaceWidth_ = eglWidth > 0 ? eglWidth : 0;
+    surfaceHeight_ = eglHeight > 0 ? eglHeight : 0;
+    OH_LOG_INFO(LOG_APP, "Reattached context to surface %{public}dx%{public}d", surfaceWidth_, surfaceHeight_);
+    return true;
+}
+
+// Drop the current surface (window or offscreen) and its native window,
+// keeping display, context and all GL objects
+void VncRenderer::releaseSurface() {
+    eglMakeCurrent(eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (eglSurface_ != nullptr) {
+        eglDestroySurface(eglDisplay_, eglSurface_);
+        eglSurface_ = nullptr;
+    }
+    if (nativeWindow_ != nullptr) {
+        OH_NativeWindow_DestroyNativeWindow(nativeWindow_);
+        nativeWindow_ = nullptr;
+    }
+    surfaceWidth_ = 0;
+    surfaceHeight_ = 0;
+}
+
+// Offscreen EGL: no window, all rendering goes to FBOs. Works with software EGL too.
+bool VncRenderer::initEGLHeadless() {
+    eglDisplay_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (eglDisplay_ == EGL_NO_DISPLAY) {
+        OH_LOG_ERROR(LOG_APP, "Headless: failed to get EGL display");
+        return false;
+    }
+
+    EGLint majorVersion = 0, minorVersion = 0;
+    if (!eglInitialize(eglDisplay_, &majorVersion, &minorVersion)) {
+        OH_LOG_ERROR(LOG_APP, "Headless: failed to initialize EGL");
+        eglDisplay_ = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    // Window-capable if possible so a surface can be attached later
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_WINDOW_BIT | EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(eglDisplay_, configAttribs, &eglConfig_, 1, &numConfigs) || numConfigs < 1) {
+        configAttribs[1] = EGL_PBUFFER_BIT;
+        numConfigs = 0;
+    }
+    if (numConfigs < 1 && (!eglChooseConfig(eglDisplay_, configAttribs, &eglConfig_, 1, &numConfigs) ||
+                           numConfigs < 1)) {
+        OH_LOG_ERROR(LOG_APP, "Headless: no pbuffer EGL config: err=%{public}d", eglGetError());
+        eglTerminate(eglDisplay_);
+        eglDisplay_ = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    eglContext_ = createGlesContext(eglDisplay_, eglConfig_);
+    if (eglContext_ == nullptr || !createOffscreenSurface() ||
+        !eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_, eglContext_)) {
+        OH_LOG_ERROR(LOG_APP, "Headless: no usable GLES context: err=%{public}d", eglGetError());
+        if (eglContext_ != nullptr) {
+            eglDestroyContext(eglDisplay_, eglContext_);
+            eglContext_ = nullptr;
+        }
+        if (eglSurface_ != nullptr) {
+            eglDestroySurface(eglDisplay_, eglSurface_);
+            eglSurface_ = nullptr;
+        }
+        eglTerminate(eglDisplay_);
+        eglDisplay_ = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    // No window: nothing is presented, surface size stays 0
+    surfaceWidth_ = 0;
+    surfaceHeight_ = 0;
+    OH_LOG_INFO(LOG_APP, "Headless EGL %{public}d.%{public}d initialized", majorVersion, minorVersion);
+    return true;
+}
+
+void VncRenderer::initPartialPresent() {
+    const char* ext = eglQueryString(eglDisplay_, EGL_EXTENSIONS);
+    auto has = [ext](const char* name) { return ext && strstr(ext, name) != nullptr; };
+
+    swapWithDamage_ = nullptr;
+    setDamageRegion_ = nullptr;
+    if (has("EGL_KHR_swap_buffers_with_damage")) {
+        swapWithDamage_ = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageKHR"));
+    } else if (has("EGL_EXT_swap_buffers_with_damage")) {
+        swapWithDamage_ = reinterpret_cast<PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC>(
+            eglGetProcAddress("eglSwapBuffersWithDamageEXT"));
+    }
+    hasBufferAge_ = has("EGL_EXT_buffer_age") || has("EGL_KHR_partial_update");
+    if (has("EGL_KHR_partial_update")) {
+        setDamageRegion_ = reinterpret_cast<PFNEGLSETDAMAGEREGIONKHRPROC>(
+            eglGetProcAddress("eglSetDamageRegionKHR"));
+    }
+    historyCount_ = 0;
+
+    OH_LOG_INFO(LOG_APP, "Partial present: swapWithDamage=%{public}d bufferAge=%{public}d partialUpdate=%{public}d",
+                swapWithDamage_ != nullptr, hasBufferAge_, setDamageRegion_ != nullptr);
+}
+
+void VncRenderer::initGpuTimer() {
+    const char* ext = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    genQueries_ = nullptr;
+    if (ext && strstr(ext, "GL_EXT_disjoint_timer_query")) {
+        genQueries_ = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(eglGetProcAddress("glGenQueriesEXT"));
+        deleteQueries_ = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(eglGetProcAddress("glDeleteQueriesEXT"));
+        beginQuery_ = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(eglGetProcAddress("glBeginQueryEXT"));
+        endQuery_ = reinterpret_cast<PFNGLENDQUERYEXTPROC>(eglGetProcAddress("glEndQueryEXT"));
+        getQueryObjectuiv_ = reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(
+            eglGetProcAddress("glGetQueryObjectuivEXT"));
+        getQueryObjectui64v_ = reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(
+            eglGetProcAddress("glGetQueryObjectui64vEXT"));
+        if (!deleteQueries_ || !beginQuery_ || !endQuery_ || !getQueryObjectuiv_ || !getQueryObjectui64v_) {
+            genQueries_ = nullptr;
         }
     }
-    OH_LOG_INFO(LOG_APP, "Using %{public}s shaders", isGLES3 ? "ES3" : "ES2");
+    if (genQueries_) {
+        genQueries_(GPU_QUERY_COUNT, gpuQueries_);
+    }
+    gpuQueryIndex_ = 0;
+    gpuQueryActive_ = false;
+    lastGpuUs_ = 0;
+    OH_LOG_INFO(LOG_APP, "GPU timer queries: %{public}s", genQueries_ ? "on" : "off");
+}
 
-    const char* vertSrc = isGLES3 ? VERTEX_SHADER_ES3 : VERTEX_SHADER_ES2;
-    const char* fragSrc = isGLES3 ? FRAGMENT_SHADER_ES3 : FRAGMENT_SHADER_ES2;
+// Time the GPU work of one frame (uploads + draw); skipped while the next
+// query object still has an unread result
+void VncRenderer::beginGpuTimer() {
+    if (!genQueries_ || gpuQueryPending_[gpuQueryIndex_]) return;
+    beginQuery_(GL_TIME_ELAPSED_EXT, gpuQueries_[gpuQueryIndex_]);
+    gpuQueryActive_ = true;
+}
 
+void VncRenderer::endGpuTimer() {
+    if (!gpuQueryActive_) return;
+    endQuery_(GL_TIME_ELAPSED_EXT);
+    gpuQueryActive_ = false;
+    gpuQueryPending_[gpuQueryIndex_] = true;
+    gpuQueryIndex_ = (gpuQueryIndex_ + 1) % GPU_QUERY_COUNT;
+}
+
+void VncRenderer::collectGpuTimers() {
+    if (!genQueries_) return;
+
+    // A disjoint event (frequency change, context loss) invalidates all results
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    for (int i = 0; i < GPU_QUERY_COUNT; i++) {
+        if (!gpuQueryPending_[i]) continue;
+        GLuint available = 0;
+        getQueryObjectuiv_(gpuQueries_[i], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available) continue;
+        GLuint64 ns = 0;
+        getQueryObjectui64v_(gpuQueries_[i], GL_QUERY_RESULT_EXT, &ns);
+        gpuQueryPending_[i] = false;
+        if (!disjoint) {
+            lastGpuUs_ = static_cast<uint32_t>(ns / 1000);
+        }
+    }
+}
+
+RenderStatsSummary VncRenderer::getStats() {
+    return stats_.summarize();
+}
+
+void VncRenderer::pushScreenDamage(const DamageRegion& damage) {
+    for (int i = DAMAGE_HISTORY - 1; i > 0; i--) {
+        screenHistory_[i] = screenHistory_[i - 1];
+    }
+    screenHistory_[0] = damage;
+    if (historyCount_ < DAMAGE_HISTORY) historyCount_++;
+}
+
+// Compile and link; bindAttrib pins a_pos to 0 for ES2 (ES3 uses layout)
+static GLuint linkProgram(const char* vertSrc, const char* fragSrc, bool bindAttrib, bool retrievable) {
     GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertSrc);
     if (vertexShader == 0) {
         OH_LOG_ERROR(LOG_APP, "Vertex shader compilation failed");
-        return false;
+        return 0;
     }
 
     GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
     if (fragmentShader == 0) {
         OH_LOG_ERROR(LOG_APP, "Fragment shader compilation failed");
         glDeleteShader(vertexShader);
-        return false;
+        return 0;
     }
 
-    shaderProgram_ = glCreateProgram();
-    if (shaderProgram_ == 0) {
+    GLuint program = glCreateProgram();
+    if (program == 0) {
         OH_LOG_ERROR(LOG_APP, "glCreateProgram failed: %{public}d", glGetError());
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
-        return false;
+        return 0;
     }
 
-    if (!isGLES3) {
-        glBindAttribLocation(shaderProgram_, 0, "a_pos");
-        glBindAttribLocation(shaderProgram_, 1, "a_texCoord");
+    if (bindAttrib) {
+        glBindAttribLocation(program, 0, "a_pos");
+    }
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     }
 
-    glAttachShader(shaderProgram_, vertexShader);
-    glAttachShader(shaderProgram_, fragmentShader);
-    glLinkProgram(shaderProgram_);
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
 
     GLint linked = 0;
-    glGetProgramiv(shaderProgram_, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if (!linked) {
         GLint infoLen = 0;
-        glGetProgramiv(shaderProgram_, GL_INFO_LOG_LENGTH, &infoLen);
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLen);
         if (infoLen > 1) {
             char* infoLog = new char[infoLen];
-            glGetProgramInfoLog(shaderProgram_, infoLen, nullptr, infoLog);
+            glGetProgramInfoLog(program, infoLen, nullptr, infoLog);
             OH_LOG_ERROR(LOG_APP, "Program link error: %{public}s", infoLog);
             delete[] infoLog;
         }
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        glDeleteProgram(shaderProgram_);
-        shaderProgram_ = 0;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Program binary cache file: header followed by the driver blob
+struct ProgramBinaryHeader {
+    uint32_t magic;
+    uint32_t format;        // GLenum binaryFormat
+    uint64_t key;
+    uint32_t length;
+    uint32_t reserved;
+};
+static constexpr uint32_t PROGRAM_BINARY_MAGIC = 0x42505348;    // "HSPB"
+
+void VncRenderer::setProgramCacheDir(const char* dir) {
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    programCacheDir_ = dir ? dir : "";
+}
+
+bool VncRenderer::loadProgramBinary(GLuint program, uint64_t key) {
+    std::string path = programCacheDir_ + "/vnc_program.bin";
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    ProgramBinaryHeader header{};
+    std::vector<uint8_t> blob;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.magic == PROGRAM_BINARY_MAGIC &&
+              header.key == key && header.length > 0 && header.length <= (1u << 24);
+    if (ok) {
+        blob.resize(header.length);
+        ok = fread(blob.data(), 1, blob.size(), f) == blob.size();
+    }
+    fclose(f);
+    if (!ok) return false;
+
+    glProgramBinary(program, header.format, blob.data(), static_cast<GLsizei>(blob.size()));
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Driver rejected it (e.g. updated); recompiling rewrites the file
+        OH_LOG_INFO(LOG_APP, "Cached program binary rejected, recompiling");
         return false;
     }
+    OH_LOG_INFO(LOG_APP, "Loaded program binary from cache (%{public}u bytes)", header.length);
+    return true;
+}
+
+void VncRenderer::saveProgramBinary(GLuint program, uint64_t key) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<uint8_t> blob(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format, blob.data());
+    if (written <= 0) return;
+
+    // Write then rename, so a crash never leaves a truncated cache behind
+    std::string path = programCacheDir_ + "/vnc_program.bin";
+    std::string tmpPath = path + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if (!f) {
+        OH_LOG_WARN(LOG_APP, "Cannot write program cache %{public}s", tmpPath.c_str());
+        return;
+    }
+    ProgramBinaryHeader header{PROGRAM_BINARY_MAGIC, format, key, static_cast<uint32_t>(written), 0};
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(blob.data(), 1, written, f) == static_cast<size_t>(written);
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return;
+    }
+    OH_LOG_INFO(LOG_APP, "Saved program binary to cache (%{public}d bytes)", written);
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+bool VncRenderer::createShaders() {
+    const char* glVersionStr = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    bool isGLES3 = false;
+    if (glVersionStr) {
+        int major = 0;
+        if (sscanf(glVersionStr, "OpenGL ES %d.", &major) == 1) {
+            isGLES3 = (major >= 3);
+        }
+    }
+    OH_LOG_INFO(LOG_APP, "Using %{public}s shaders", isGLES3 ? "ES3" : "ES2");
+    isGLES3_ = isGLES3;
+
+    const char* vertSrc = isGLES3 ? VERTEX_SHADER_ES3 : VERTEX_SHADER_ES2;
+    const char* fragSrc = isGLES3 ? FRAGMENT_SHADER_ES3 : FRAGMENT_SHADER_ES2;
+
+    // ES3 can skip compile + link on later starts via the driver's program
+    // binary; the key invalidates the cache on shader or driver updates
+    bool useCache = isGLES3 && !programCacheDir_.empty();
+    uint64_t cacheKey = 0;
+    bool loaded = false;
+    if (useCache) {
+        const char* renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        std::string id = std::string(vertSrc) + fragSrc + (renderer ? renderer : "") + glVersionStr;
+        cacheKey = std::hash<std::string>{}(id);
+        shaderProgram_ = glCreateProgram();
+        loaded = shaderProgram_ != 0 && loadProgramBinary(shaderProgram_, cacheKey);
+        if (!loaded && shaderProgram_ != 0) {
+            glDeleteProgram(shaderProgram_);
+            shaderProgram_ = 0;
+        }
+    }
+
+    if (!loaded) {
+        shaderProgram_ = linkProgram(vertSrc, fragSrc, !isGLES3, useCache);
+        if (shaderProgram_ == 0) return false;
+        if (useCache) saveProgramBinary(shaderProgram_, cacheKey);
+    }
 
     posLoc_ = glGetAttribLocation(shaderProgram_, "a_pos");
-    texCoordLoc_ = glGetAttribLocation(shaderProgram_, "a_texCoord");
     texLoc_ = glGetUniformLocation(shaderProgram_, "u_tex");
+    dstRectLoc_ = glGetUniformLocation(shaderProgram_, "u_dstRect");
+    srcRectLoc_ = glGetUniformLocation(shaderProgram_, "u_srcRect");
+    swizzleLoc_ = glGetUniformLocation(shaderProgram_, "u_swizzle");
 
-    if (posLoc_ < 0 || texCoordLoc_ < 0 || texLoc_ < 0) {
+    if (posLoc_ < 0 || texLoc_ < 0 || dstRectLoc_ < 0 || srcRectLoc_ < 0 || swizzleLoc_ < 0) {
         OH_LOG_ERROR(LOG_APP, "Invalid shader attribute/uniform locations");
         return false;
     }
@@ -369,11 +845,12 @@ bool VncRenderer::createShaders() {
 }
 
 bool VncRenderer::initGL() {
+    // Unit quad; the vertex shader places it per tile
     const float vertices[] = {
-        -1.0f,  1.0f,    0.0f, 0.0f,
-         1.0f,  1.0f,    1.0f, 0.0f,
-        -1.0f, -1.0f,    0.0f, 1.0f,
-         1.0f, -1.0f,    1.0f, 1.0f,
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f,
     };
 
     glGenVertexArrays(1, &vao_);
@@ -386,85 +863,206 @@ bool VncRenderer::initGL() {
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(posLoc_);
-    glVertexAttribPointer(posLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-
-    glEnableVertexAttribArray(texCoordLoc_);
-    glVertexAttribPointer(texCoordLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                          reinterpret_cast<void*>(2 * sizeof(float)));
+    glVertexAttribPointer(posLoc_, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
 
     if (vao_ != 0) {
         glBindVertexArray(0);
     }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glDisableVertexAttribArray(posLoc_);
-    glDisableVertexAttribArray(texCoordLoc_);
 
-    glGenTextures(1, &textureId_);
-    if (textureId_ == 0) {
-        OH_LOG_ERROR(LOG_APP, "glGenTextures failed: %{public}d", glGetError());
-        return false;
+    // Tile textures are created once the framebuffer size is known;
+    // leave room for the 1px border on both sides
+    GLint maxTexSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
+    tileSize_ = TILE_SIZE;
+    if (maxTexSize > 2 && maxTexSize - 2 < tileSize_) {
+        tileSize_ = maxTexSize - 2;
     }
-    glBindTexture(GL_TEXTURE_2D, textureId_);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    OH_LOG_INFO(LOG_APP, "OpenGL initialized: VAO=%{public}u VBO=%{public}u TEX=%{public}u",
-                vao_, vbo_, textureId_);
+    // PBOs are sized lazily on first upload (framebuffer size unknown here)
+    if (isGLES3_) {
+        glGenBuffers(PBO_COUNT, pbos_);
+        pboIndex_ = 0;
+    }
+
+    OH_LOG_INFO(LOG_APP, "OpenGL initialized: VAO=%{public}u VBO=%{public}u tile=%{public}d maxTex=%{public}d "
+                "PBO=%{public}s", vao_, vbo_, tileSize_, maxTexSize, isGLES3_ ? "on" : "off");
     return true;
 }
 
+void VncRenderer::deleteTiles() {
+    for (Tile& t : tiles_) {
+        if (t.tex != 0) glDeleteTextures(1, &t.tex);
+    }
+    tiles_.clear();
+}
+
+// Allocate the tile grid for a new framebuffer size or pixel format
+// (contents follow as a full upload)
+void VncRenderer::rebuildTiles(int width, int height, int bytesPerPixel) {
+    deleteTiles();
+    texBytesPerPixel_ = bytesPerPixel;
+    if (bytesPerPixel == 4) {
+        texFormat_ = GL_RGBA;
+        texType_ = GL_UNSIGNED_BYTE;
+    } else {
+        texFormat_ = GL_RGB;
+        texType_ = GL_UNSIGNED_SHORT_5_6_5;
+    }
+
+    const DamageRect fb{0, 0, width, height};
+    for (int y = 0; y < height; y += tileSize_) {
+        for (int x = 0; x < width; x += tileSize_) {
+            Tile t{};
+            t.content = DamageRect{x, y, tileSize_, tileSize_}.intersection(fb);
+            t.texRect = DamageRect{t.content.x - 1, t.content.y - 1,
+                                   t.content.w + 2, t.content.h + 2}.intersection(fb);
+            glGenTextures(1, &t.tex);
+            glBindTexture(GL_TEXTURE_2D, t.tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexImage2D(GL_TEXTURE_2D, 0, texFormat_, t.texRect.w, t.texRect.h, 0,
+                         texFormat_, texType_, nullptr);
+            tiles_.push_back(t);
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    OH_LOG_INFO(LOG_APP, "Tile grid: %{public}dx%{public}d %{public}dbpp -> %{public}zu tiles",
+                width, height, bytesPerPixel * 8, tiles_.size());
+}
+
 void VncRenderer::markDirty(int x, int y, int w, int h) {
     {
         std::lock_guard<std::mutex> lock(dirtyMutex_);
-        if (!dirty_.load()) {
-            dirtyX_ = x;
-            dirtyY_ = y;
-            dirtyW_ = w;
-            dirtyH_ = h;
-        } else {
-            int nx2 = x + w;
-            int ny2 = y + h;
-            int ox2 = dirtyX_ + dirtyW_;
-            int oy2 = dirtyY_ + dirtyH_;
-            dirtyX_ = std::min(dirtyX_, x);
-            dirtyY_ = std::min(dirtyY_, y);
-            dirtyW_ = std::max(ox2, nx2) - dirtyX_;
-            dirtyH_ = std::max(oy2, ny2) - dirtyY_;
-        }
+        dirtyRegion_.add(x, y, w, h);
     }
     dirty_.store(true, std::memory_order_release);
+    requestFrame();
+}
+
+void VncRenderer::setViewTransform(float zoom, float panX, float panY) {
+    if (!(zoom >= 1.0f)) zoom = 1.0f;  // also rejects NaN
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex_);
+        view_ = ViewTransform{zoom, panX, panY};
+        viewChanged_ = true;
+    }
+    dirty_.store(true, std::memory_order_release);
+    requestFrame();
+}
+
+void VncRenderer::setFrameRateCap(int fps) {
+    frameRateCap_.store(fps > 0 ? fps : 0, std::memory_order_relaxed);
+    OH_LOG_INFO(LOG_APP, "Frame rate cap: %{public}d", fps);
+}
+
+// Lock/unlock before notifying so a wakeup cannot slip in between the render
+// thread's predicate check and its wait (there is no timeout to recover)
+void VncRenderer::wakeRenderThread() {
+    { std::lock_guard<std::mutex> lk(renderWakeMutex_); }
     renderWakeCv_.notify_one();
 }
 
+void VncRenderer::requestFrame() {
+    OH_NativeVSync* vsync = vsyncPaced_.load(std::memory_order_acquire) ? vsync_.load() : nullptr;
+    if (vsync == nullptr) {
+        wakeRenderThread();
+        return;
+    }
+    if (!vsyncRequested_.exchange(true, std::memory_order_acq_rel)) {
+        if (OH_NativeVSync_RequestFrame(vsync, onVsync, nullptr) != 0) {
+            // Vsync source refused the request: don't leave damage stranded
+            vsyncRequested_.store(false, std::memory_order_release);
+            vsyncTick_.store(true, std::memory_order_release);
+            wakeRenderThread();
+        }
+    }
+}
+
+// Called on the vsync thread once per requested frame
+void VncRenderer::onVsync(long long timestamp, void* data) {
+    vsyncRequested_.store(false, std::memory_order_release);
+    vsyncTick_.store(true, std::memory_order_release);
+    wakeRenderThread();
+}
+
 // ---- Render thread main loop ----
 void VncRenderer::renderLoop() {
     OH_LOG_INFO(LOG_APP, "Render thread started");
 
     if (!eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_, eglContext_)) {
         OH_LOG_ERROR(LOG_APP, "Render thread: eglMakeCurrent failed: 0x%{public}x", eglGetError());
+        renderRunning_.store(false, std::memory_order_release);
+        finishCapture(false);
         return;
     }
 
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point lastFrame = Clock::now() - std::chrono::seconds(1);
+    const bool vsyncPaced = vsyncPaced_.load(std::memory_order_acquire);
+
     while (renderRunning_.load(std::memory_order_acquire)) {
+        // Headless: nothing to present, damage is consumed by captures
+        auto pending = [] {
+            if (headless_.load(std::memory_order_acquire)) return false;
+            return dirty_.load(std::memory_order_acquire) || surfaceResized_.load(std::memory_order_acquire);
+        };
+        CaptureRequest* capture = nullptr;
         {
+            // Idle: sleep until damage arrives (vsync mode also waits for the tick)
+            // or a capture is requested (served right away, no vsync)
             std::unique_lock<std::mutex> lk(renderWakeMutex_);
-            renderWakeCv_.wait_for(lk, std::chrono::milliseconds(100),
-                [] { return dirty_.load(std::memory_order_acquire) ||
-                             surfaceResized_.load(std::memory_order_acquire) ||
-                             !renderRunning_.load(std::memory_order_acquire); });
+            renderWakeCv_.wait(lk, [&] {
+                if (!renderRunning_.load(std::memory_order_acquire)) return true;
+                if (captureRequest_ != nullptr) return true;
+                if (vsyncPaced) return vsyncTick_.load(std::memory_order_acquire) && pending();
+                return pending();
+            });
+            capture = captureRequest_;
         }
 
         if (!renderRunning_.load(std::memory_order_acquire)) break;
+        if (capture != nullptr) {
+            serviceCapture(*capture);
+            finishCapture(true);
+            continue;
+        }
+        vsyncTick_.store(false, std::memory_order_release);
+
+        int cap = frameRateCap_.load(std::memory_order_relaxed);
+        if (cap > 0) {
+            auto minInterval = std::chrono::nanoseconds(1000000000LL / cap);
+            auto elapsed = Clock::now() - lastFrame;
+            if (vsyncPaced) {
+                // Skip this vsync if presenting now would exceed the cap; half a
+                // period of slack keeps cap == refresh rate from dropping frames
+                if (elapsed + std::chrono::nanoseconds(vsyncPeriodNs_ / 2) < minInterval) {
+                    requestFrame();
+                    continue;
+                }
+            } else if (elapsed < minInterval) {
+                // No vsync source: timed pacing, only while damage is pending
+                std::unique_lock<std::mutex> lk(renderWakeMutex_);
+                renderWakeCv_.wait_until(lk, lastFrame + minInterval,
+                    [] { return !renderRunning_.load(std::memory_order_acquire); });
+                if (!renderRunning_.load(std::memory_order_acquire)) break;
+            }
+        }
 
+        lastFrame = Clock::now();
         renderFrameInternal();
+
+        // Damage that arrived during this frame (or was put back) needs another vsync
+        if (pending()) {
+            requestFrame();
+        }
     }
 
+    finishCapture(false);
     eglMakeCurrent(eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     OH_LOG_INFO(LOG_APP, "Render thread stopped");
 }
@@ -474,13 +1072,16 @@ void VncRenderer::renderFrameInternal() {
     if (!dirty_.load(std::memory_order_acquire) && !surfaceResized_.load(std::memory_order_acquire)) return;
 
     // Grab and clear dirty region
-    int x, y, w, h;
+    DamageRegion region;
+    ViewTransform view;
+    bool viewChanged;
     {
         std::lock_guard<std::mutex> lock(dirtyMutex_);
-        x = dirtyX_;
-        y = dirtyY_;
-        w = dirtyW_;
-        h = dirtyH_;
+        region = dirtyRegion_;
+        dirtyRegion_.clear();
+        view = view_;
+        viewChanged = viewChanged_;
+        viewChanged_ = false;
         dirty_.store(false, std::memory_order_release);
     }
 
@@ -503,103 +1104,416 @@ void VncRenderer::renderFrameInternal() {
     }
 
     if (surfWidth <= 0 || surfHeight <= 0) {
+        // Surface not ready: put the damage back for the next pass
+        std::lock_guard<std::mutex> lock(dirtyMutex_);
+        dirtyRegion_.add(region);
+        viewChanged_ = viewChanged_ || viewChanged;
         dirty_.store(true, std::memory_order_release);
         return;
     }
 
-    // Upload dirty region to texture
-    updateTexture(x, y, w, h, needFullUpload);
+    using Clock = std::chrono::steady_clock;
+    auto micros = [](Clock::duration d) {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    };
+    Clock::time_point frameStart = Clock::now();
+    collectGpuTimers();
+    beginGpuTimer();
+
+    // Upload visible dirty tiles (a framebuffer resize or view change repaints everything)
+    frameUploadBytes_ = 0;
+    frameUploadRects_ = 0;
+    frameCoalesced_ = 0;
+    bool fullFrame = updateTexture(region, needFullUpload, view) || needFullUpload || viewChanged;
+    Clock::time_point uploadEnd = Clock::now();
+
+    if (vncWidth_ <= 0 || vncHeight_ <= 0) {
+        endGpuTimer();
+        return;
+    }
 
-    if (vncWidth_ <= 0 || vncHeight_ <= 0) return;
+    ScreenMapping mapping = calcMapping(surfaceWidth_, surfaceHeight_, vncWidth_, vncHeight_,
+                                        view.zoom, view.panX, view.panY);
+    const DamageRect fullScreen{0, 0, surfaceWidth_, surfaceHeight_};
 
-    // Draw with letterbox viewport
-    int vpX, vpY, vpW, vpH;
-    calcViewport(surfaceWidth_, surfaceHeight_, vncWidth_, vncHeight_, vpX, vpY, vpW, vpH);
+    // This frame's damage in surface pixels
+    DamageRegion screenDamage;
+    if (fullFrame) {
+        screenDamage.add(fullScreen);
+    } else {
+        for (const DamageRect& r : region) {
+            screenDamage.add(fbRectToScreen(r, mapping));
+        }
+    }
 
+    // Repaint = this frame's damage + whatever the reused back buffer missed.
+    // Age 0 (undefined contents) or older than our history means full redraw.
+    EGLint age = 0;
+    if (hasBufferAge_ && !fullFrame) {
+        eglQuerySurface(eglDisplay_, eglSurface_, EGL_BUFFER_AGE_EXT, &age);
+    }
+    bool partial = age > 0 && age - 1 <= historyCount_;
+    DamageRegion repaint = screenDamage;
+    for (int i = 0; partial && i < age - 1; i++) {
+        repaint.add(screenHistory_[i]);
+    }
+    if (!partial || repaint.area() >= fullScreen.area()) {
+        partial = false;
+        repaint.clear();
+        repaint.add(fullScreen);
+    }
+
+    EGLint eglRects[DamageRegion::MAX_RECTS * 4];
+    if (partial && setDamageRegion_) {
+        int n = toEglRects(repaint, surfaceHeight_, eglRects);
+        setDamageRegion_(eglDisplay_, eglSurface_, eglRects, n);
+    }
+
+    // Clear and draw the visible tiles, restricted to the repaint rects if partial
     glViewport(0, 0, surfaceWidth_, surfaceHeight_);
-    glClear(GL_COLOR_BUFFER_BIT);
+    if (partial) {
+        for (const DamageRect& r : repaint) {
+            // drawTiles() leaves scissoring disabled, re-enable per rect
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(r.x, surfaceHeight_ - (r.y + r.h), r.w, r.h);
+            glClear(GL_COLOR_BUFFER_BIT);
+            drawTiles(mapping, r, surfaceWidth_, surfaceHeight_);
+        }
+        glDisable(GL_SCISSOR_TEST);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT);
+        drawTiles(mapping, fullScreen, surfaceWidth_, surfaceHeight_);
+    }
+
+    endGpuTimer();
+
+    // Tell the compositor only what changed since the previous frame
+    Clock::time_point swapStart = Clock::now();
+    EGLBoolean swapped;
+    if (swapWithDamage_ && !fullFrame) {
+        int n = toEglRects(screenDamage, surfaceHeight_, eglRects);
+        swapped = swapWithDamage_(eglDisplay_, eglSurface_, eglRects, n);
+    } else {
+        swapped = eglSwapBuffers(eglDisplay_, eglSurface_);
+    }
+    Clock::time_point frameEnd = Clock::now();
+    if (!swapped) {
+        OH_LOG_ERROR(LOG_APP, "eglSwapBuffers failed: 0x%{public}x", eglGetError());
+    }
+    pushScreenDamage(screenDamage);
+
+    FrameStats fs;
+    fs.timestampMs = static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(frameEnd.time_since_epoch()).count());
+    fs.uploadBytes = frameUploadBytes_;
+    fs.uploadRects = frameUploadRects_;
+    fs.uploadUs = micros(uploadEnd - frameStart);
+    fs.gpuUs = lastGpuUs_;
+    fs.swapUs = micros(frameEnd - swapStart);
+    fs.frameUs = micros(frameEnd - frameStart);
+    fs.coalesced = frameCoalesced_;
+    stats_.push(fs);
+}
 
-    glViewport(vpX, vpY, vpW, vpH);
+// Draw every tile that intersects screenClip (target pixels, top-left origin),
+// scissored to screenClip and the mapping's clip. Viewport must be the whole
+// targetWidth x targetHeight render target.
+void VncRenderer::drawTiles(const ScreenMapping& m, const DamageRect& screenClip, int targetWidth, int targetHeight) {
+    if (tiles_.empty() || vncWidth_ <= 0 || vncHeight_ <= 0) return;
+
+    DamageRect clip = screenClip.intersection(m.clip);
+    if (clip.empty()) return;
+
+    // Scissor replaces (not narrows) any caller scissor; clip already includes it
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(clip.x, targetHeight - (clip.y + clip.h), clip.w, clip.h);
 
     glUseProgram(shaderProgram_);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureId_);
     glUniform1i(texLoc_, 0);
-
+    glUniform1f(swizzleLoc_, texBytesPerPixel_ == 4 ? 1.0f : 0.0f);
     if (vao_ != 0) {
         glBindVertexArray(vao_);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-        glBindVertexArray(0);
     } else {
         glBindBuffer(GL_ARRAY_BUFFER, vbo_);
         glEnableVertexAttribArray(posLoc_);
-        glVertexAttribPointer(posLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-        glEnableVertexAttribArray(texCoordLoc_);
-        glVertexAttribPointer(texCoordLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                              reinterpret_cast<void*>(2 * sizeof(float)));
+        glVertexAttribPointer(posLoc_, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+    }
+
+    const float sx = 2.0f / targetWidth;
+    const float sy = 2.0f / targetHeight;
+    for (const Tile& t : tiles_) {
+        // Screen rect of the tile's content, culled against the clip
+        float x0 = m.originX + t.content.x * m.scale;
+        float y0 = m.originY + t.content.y * m.scale;
+        float w = t.content.w * m.scale;
+        float h = t.content.h * m.scale;
+        if (x0 >= clip.x + clip.w || x0 + w <= clip.x || y0 >= clip.y + clip.h || y0 + h <= clip.y) {
+            continue;
+        }
+
+        // NDC (y up) and the content part of the bordered texture
+        glUniform4f(dstRectLoc_, x0 * sx - 1.0f, 1.0f - y0 * sy, w * sx, -h * sy);
+        glUniform4f(srcRectLoc_,
+                    static_cast<float>(t.content.x - t.texRect.x) / t.texRect.w,
+                    static_cast<float>(t.content.y - t.texRect.y) / t.texRect.h,
+                    static_cast<float>(t.content.w) / t.texRect.w,
+                    static_cast<float>(t.content.h) / t.texRect.h);
+        glBindTexture(GL_TEXTURE_2D, t.tex);
         glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+    if (vao_ != 0) {
+        glBindVertexArray(0);
+    } else {
         glDisableVertexAttribArray(posLoc_);
-        glDisableVertexAttribArray(texCoordLoc_);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
     glBindTexture(GL_TEXTURE_2D, 0);
+    glDisable(GL_SCISSOR_TEST);
+}
 
-    if (!eglSwapBuffers(eglDisplay_, eglSurface_)) {
-        OH_LOG_ERROR(LOG_APP, "eglSwapBuffers failed: 0x%{public}x", eglGetError());
+// Queue damage on the tiles it touches and upload the ones currently visible
+// (or all of them, for captures).
+// Returns true if the framebuffer size changed (tiles rebuilt, full upload).
+bool VncRenderer::updateTexture(const DamageRegion& region, bool forceFull, const ViewTransform& view,
+                                bool allTiles) {
+    // Latest complete frame; it stays untouched by the poll thread until released
+    const VncFrame* frame = acquireFrame();
+    if (!frame) return false;
+
+    // Frames published since the last one we saw were replaced unseen
+    if (frame->seq > lastFrameSeq_ + 1 && lastFrameSeq_ != 0) {
+        frameCoalesced_ = static_cast<uint32_t>(frame->seq - lastFrameSeq_ - 1);
     }
+    lastFrameSeq_ = frame->seq;
+
+    bool resized = false;
+    if (frame->width != vncWidth_ || frame->height != vncHeight_ ||
+        frame->bytesPerPixel != texBytesPerPixel_ || tiles_.empty()) {
+        resized = true;
+        vncWidth_ = frame->width;
+        vncHeight_ = frame->height;
+        rebuildTiles(vncWidth_, vncHeight_, frame->bytesPerPixel);
+        forceFull = true;
+    }
+
+    // A rect near a tile edge also lands in the neighbour's border
+    for (Tile& t : tiles_) {
+        if (forceFull) {
+            t.pending.clear();
+            t.pending.add(t.texRect);
+            continue;
+        }
+        for (const DamageRect& r : region) {
+            DamageRect in = r.intersection(t.texRect);
+            if (!in.empty()) t.pending.add(in);
+        }
+    }
+
+    // Only tiles on screen are uploaded; the rest keep their damage until panned in
+    ScreenMapping m = calcMapping(surfaceWidth_, surfaceHeight_, vncWidth_, vncHeight_,
+                                  view.zoom, view.panX, view.panY);
+    DamageRect visible = allTiles ? DamageRect{0, 0, vncWidth_, vncHeight_}
+                                  : visibleFbRect(m, vncWidth_, vncHeight_);
+    uploads_.clear();
+    for (Tile& t : tiles_) {
+        if (t.pending.empty() || !t.texRect.intersects(visible)) continue;
+        for (const DamageRect& r : t.pending) {
+            uploads_.push_back(TileUpload{&t, r});
+        }
+        t.pending.clear();
+    }
+
+    if (!uploads_.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (!(isGLES3_ && uploadViaPbo(*frame))) {
+            uploadDirect(*frame);
+        }
+        statUploadNs_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        statUploadBatches_++;
+        for (const TileUpload& u : uploads_) {
+            statUploadPixels_ += static_cast<uint64_t>(u.r.area());
+            frameUploadBytes_ += static_cast<uint32_t>(u.r.area() * frame->bytesPerPixel);
+        }
+        frameUploadRects_ = static_cast<uint32_t>(uploads_.size());
+    }
+    releaseFrame();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return resized;
 }
 
-void VncRenderer::updateTexture(int x, int y, int w, int h, bool forceFull) {
-    if (textureId_ == 0) return;
+// In-process QEMU surface while the bridge is attached, decoded VNC otherwise
+const VncFrame* VncRenderer::acquireFrame() {
+    frameFromBridge_ = DisplayBridge::isActive();
+    return frameFromBridge_ ? DisplayBridge::acquireFrame() : VncClient::acquireFrame();
+}
 
-    int vw, vh;
-    uint8_t* fb;
-    {
-        std::lock_guard<std::mutex> lock(VncClient::getFbMutex());
-        fb = VncClient::getFrameBuffer();
-        if (!fb) return;
-        vw = VncClient::getFrameWidth();
-        vh = VncClient::getFrameHeight();
-        if (vw <= 0 || vh <= 0) return;
-
-        glBindTexture(GL_TEXTURE_2D, textureId_);
-        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
-
-        if (forceFull || vw != vncWidth_ || vh != vncHeight_) {
-            vncWidth_ = vw;
-            vncHeight_ = vh;
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, vncWidth_, vncHeight_, 0,
-                         GL_RGB, GL_UNSIGNED_SHORT_5_6_5, fb);
-        } else if (vao_ != 0) {
-            glPixelStorei(GL_UNPACK_ROW_LENGTH, vncWidth_);
-            glPixelStorei(GL_UNPACK_SKIP_PIXELS, x);
-            glPixelStorei(GL_UNPACK_SKIP_ROWS, y);
-            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h,
-                            GL_RGB, GL_UNSIGNED_SHORT_5_6_5, fb);
-            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-            glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-            glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
-        } else {
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vncWidth_, vncHeight_,
-                            GL_RGB, GL_UNSIGNED_SHORT_5_6_5, fb);
+void VncRenderer::releaseFrame() {
+    if (frameFromBridge_) {
+        DisplayBridge::releaseFrame();
+    } else {
+        VncClient::releaseFrame();
+    }
+}
+
+// Stage the upload batch into the next free PBO and update the tiles from it.
+// Returns false (nothing uploaded) if every PBO is still in use by the GPU.
+bool VncRenderer::uploadViaPbo(const VncFrame& frame) {
+    int idx = -1;
+    for (int n = 0; n < PBO_COUNT; n++) {
+        int i = (pboIndex_ + n) % PBO_COUNT;
+        if (pboFences_[i] != nullptr) {
+            // Zero timeout: never stall the render thread on the GPU
+            GLenum st = glClientWaitSync(pboFences_[i], 0, 0);
+            if (st == GL_TIMEOUT_EXPIRED) continue;
+            glDeleteSync(pboFences_[i]);
+            pboFences_[i] = nullptr;
         }
+        idx = i;
+        break;
+    }
+    if (idx < 0 || pbos_[idx] == 0) return false;
 
-        glBindTexture(GL_TEXTURE_2D, 0);
+    const size_t bpp = frame.bytesPerPixel;
+    size_t bytes = 0;
+    for (const TileUpload& u : uploads_) {
+        bytes += static_cast<size_t>(u.r.area()) * bpp;
+    }
+    // Tile borders duplicate a few rows, so a batch can slightly exceed one frame
+    const size_t frameBytes = frame.stride * frame.height;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos_[idx]);
+    if (pboCapacity_[idx] < bytes) {
+        size_t capacity = bytes > frameBytes ? bytes : frameBytes;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        pboCapacity_[idx] = capacity;
+    }
+    auto* dst = static_cast<uint8_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (!dst) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    // Pack rects back to back, rows tightly
+    uint8_t* out = dst;
+    for (const TileUpload& u : uploads_) {
+        const DamageRect& r = u.r;
+        const size_t rowBytes = static_cast<size_t>(r.w) * bpp;
+        const uint8_t* src = frame.data + r.y * frame.stride + r.x * bpp;
+        for (int row = 0; row < r.h; row++) {
+            memcpy(out, src, rowBytes);
+            out += rowBytes;
+            src += frame.stride;
+        }
+    }
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, static_cast<GLint>(bpp));
+    size_t offset = 0;
+    for (const TileUpload& u : uploads_) {
+        const DamageRect& r = u.r;
+        glBindTexture(GL_TEXTURE_2D, u.tile->tex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.x - u.tile->texRect.x, r.y - u.tile->texRect.y, r.w, r.h,
+                        texFormat_, texType_, reinterpret_cast<const void*>(offset));
+        offset += static_cast<size_t>(r.w) * r.h * bpp;
+    }
+    pboFences_[idx] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pboIndex_ = (idx + 1) % PBO_COUNT;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
+}
+
+// Synchronous upload straight from client memory (GLES2, or no free PBO)
+void VncRenderer::uploadDirect(const VncFrame& frame) {
+    const size_t bpp = frame.bytesPerPixel;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, static_cast<GLint>(bpp));
+
+    if (isGLES3_) {
+        // GLES3: sub-image uploads read the framebuffer in place
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.width);
+        for (const TileUpload& u : uploads_) {
+            const DamageRect& r = u.r;
+            glBindTexture(GL_TEXTURE_2D, u.tile->tex);
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, r.x);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, r.y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r.x - u.tile->texRect.x, r.y - u.tile->texRect.y, r.w, r.h,
+                            texFormat_, texType_, frame.data);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        return;
+    }
+
+    // GLES2 has no UNPACK_ROW_LENGTH: full-width rects are contiguous,
+    // anything narrower is packed into a scratch buffer first
+    for (const TileUpload& u : uploads_) {
+        const DamageRect& r = u.r;
+        const size_t rowBytes = static_cast<size_t>(r.w) * bpp;
+        const uint8_t* src = frame.data + r.y * frame.stride + r.x * bpp;
+        if (rowBytes != frame.stride) {
+            uploadScratch_.resize(rowBytes * r.h);
+            uint8_t* out = uploadScratch_.data();
+            for (int row = 0; row < r.h; row++) {
+                memcpy(out, src + row * frame.stride, rowBytes);
+                out += rowBytes;
+            }
+            src = uploadScratch_.data();
+        }
+        glBindTexture(GL_TEXTURE_2D, u.tile->tex);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, r.x - u.tile->texRect.x, r.y - u.tile->texRect.y, r.w, r.h,
+                        texFormat_, texType_, src);
     }
 }
 
 void VncRenderer::cleanupGL() {
     OH_LOG_INFO(LOG_APP, "Cleaning up GL resources");
 
-    // Must make context current before deleting GL objects
-    if (eglDisplay_ != EGL_NO_DISPLAY && eglSurface_ != nullptr && eglContext_ != nullptr) {
+    // Must make context current before deleting GL objects (surface may be
+    // EGL_NO_SURFACE with a surfaceless context)
+    if (eglDisplay_ != EGL_NO_DISPLAY && eglContext_ != nullptr) {
         eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_, eglContext_);
     }
 
     if (vao_ != 0) { glDeleteVertexArrays(1, &vao_); vao_ = 0; }
     if (vbo_ != 0) { glDeleteBuffers(1, &vbo_); vbo_ = 0; }
     if (shaderProgram_ != 0) { glDeleteProgram(shaderProgram_); shaderProgram_ = 0; }
-    if (textureId_ != 0) { glDeleteTextures(1, &textureId_); textureId_ = 0; }
+    deleteTiles();
+    uploads_.clear();
+    if (captureFbo_ != 0) { glDeleteFramebuffers(1, &captureFbo_); captureFbo_ = 0; }
+    if (captureTex_ != 0) { glDeleteTextures(1, &captureTex_); captureTex_ = 0; }
+    captureWidth_ = 0;
+    captureHeight_ = 0;
+    if (genQueries_) {
+        deleteQueries_(GPU_QUERY_COUNT, gpuQueries_);
+        genQueries_ = nullptr;
+    }
+    for (int i = 0; i < GPU_QUERY_COUNT; i++) {
+        gpuQueries_[i] = 0;
+        gpuQueryPending_[i] = false;
+    }
+
+    if (statUploadBatches_ > 0) {
+        double mpx = statUploadPixels_ / 1e6;
+        OH_LOG_INFO(LOG_APP, "Upload stats [%{public}dbpp %{public}s]: batches=%{public}llu pixels=%{public}.1fM "
+                    "cpu avg=%{public}lluus per-Mpx=%{public}.0fus",
+                    texBytesPerPixel_ * 8, isGLES3_ ? "pbo" : "direct",
+                    static_cast<unsigned long long>(statUploadBatches_), mpx,
+                    static_cast<unsigned long long>(statUploadNs_ / statUploadBatches_ / 1000),
+                    mpx > 0 ? statUploadNs_ / 1000.0 / mpx : 0.0);
+    }
+    statUploadBatches_ = 0;
+    statUploadPixels_ = 0;
+    statUploadNs_ = 0;
+    for (int i = 0; i < PBO_COUNT; i++) {
+        if (pboFences_[i] != nullptr) { glDeleteSync(pboFences_[i]); pboFences_[i] = nullptr; }
+        if (pbos_[i] != 0) { glDeleteBuffers(1, &pbos_[i]); pbos_[i] = 0; }
+        pboCapacity_[i] = 0;
+    }
 
     vncWidth_ = 0;
     vncHeight_ = 0;
@@ -629,120 +1543,305 @@ void VncRenderer::cleanupGL() {
     }
 
     initialized_.store(false, std::memory_order_release);
+    headless_.store(false, std::memory_order_release);
     surfaceResized_.store(false, std::memory_order_release);
     OH_LOG_INFO(LOG_APP, "GL cleanup done");
 }
 
-bool VncRenderer::init(int64_t surfaceId) {
-    OH_LOG_INFO(LOG_APP, "VncRenderer::init surfaceId=%{public}lld", static_cast<long long>(surfaceId));
-
-    if (initialized_.load(std::memory_order_acquire)) {
-        OH_LOG_WARN(LOG_APP, "Renderer already initialized, shutting down first");
-        shutdown();
-    }
-
-    if (!initEGL(surfaceId)) {
-        OH_LOG_ERROR(LOG_APP, "Failed to initialize EGL");
-        return false;
-    }
+// Shaders, buffers and per-context state (context current on this thread)
+bool VncRenderer::initResources() {
     if (!createShaders()) {
         OH_LOG_ERROR(LOG_APP, "Failed to create shaders");
-        cleanupGL();
         return false;
     }
     if (!initGL()) {
         OH_LOG_ERROR(LOG_APP, "Failed to initialize GL");
-        cleanupGL();
         return false;
     }
+    initPartialPresent();
+    initGpuTimer();
+    stats_.clear();
+    lastFrameSeq_ = 0;
+    return true;
+}
 
-    // Upload existing VNC framebuffer if already available
-    {
-        std::lock_guard<std::mutex> lock(VncClient::getFbMutex());
-        int vw = VncClient::getFrameWidth();
-        int vh = VncClient::getFrameHeight();
-        if (vw > 0 && vh > 0) {
-            uint8_t* fb = VncClient::getFrameBuffer();
-            if (fb) {
-                vncWidth_ = vw;
-                vncHeight_ = vh;
-                glBindTexture(GL_TEXTURE_2D, textureId_);
-                glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, vncWidth_, vncHeight_, 0,
-                             GL_RGB, GL_UNSIGNED_SHORT_5_6_5, fb);
-                glBindTexture(GL_TEXTURE_2D, 0);
-                OH_LOG_INFO(LOG_APP, "Uploaded initial framebuffer: %{public}dx%{public}d", vw, vh);
-            }
+bool VncRenderer::init(int64_t surfaceId) {
+    OH_LOG_INFO(LOG_APP, "VncRenderer::init surfaceId=%{public}lld", static_cast<long long>(surfaceId));
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+
+    // A live context (detached or headless) is moved onto the new window:
+    // program, tiles and PBOs survive, only the surface is recreated
+    bool reused = false;
+    if (initialized_.load(std::memory_order_acquire)) {
+        stopRenderThread();
+        releaseSurface();
+        reused = attachWindow(surfaceId);
+        if (!reused) {
+            OH_LOG_WARN(LOG_APP, "Cannot reuse GL context, reinitializing");
+            shutdownLocked();
         }
     }
 
-    // Render initial frame
+    if (!reused) {
+        if (!initEGL(surfaceId)) {
+            OH_LOG_ERROR(LOG_APP, "Failed to initialize EGL");
+            return false;
+        }
+        if (!initResources()) {
+            cleanupGL();
+            return false;
+        }
+    }
+    headless_.store(false, std::memory_order_release);
+    historyCount_ = 0;
+
+    // Upload existing VNC framebuffer if already available and render it
+    // (render thread is not running yet, so this thread is the only consumer).
+    // With reused tiles only the damage collected while detached is uploaded.
     {
+        ViewTransform view;
+        DamageRegion region;
+        {
+            std::lock_guard<std::mutex> lock(dirtyMutex_);
+            view = view_;
+            if (reused) {
+                region = dirtyRegion_;
+                dirtyRegion_.clear();
+                dirty_.store(false, std::memory_order_release);
+            }
+        }
+        updateTexture(region, !reused, view);
+        if (vncWidth_ > 0) {
+            OH_LOG_INFO(LOG_APP, "Uploaded initial framebuffer: %{public}dx%{public}d", vncWidth_, vncHeight_);
+        }
+
         glViewport(0, 0, surfaceWidth_, surfaceHeight_);
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-
         if (vncWidth_ > 0 && vncHeight_ > 0) {
-            int vpX, vpY, vpW, vpH;
-            calcViewport(surfaceWidth_, surfaceHeight_, vncWidth_, vncHeight_, vpX, vpY, vpW, vpH);
-            glViewport(vpX, vpY, vpW, vpH);
-            glUseProgram(shaderProgram_);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, textureId_);
-            glUniform1i(texLoc_, 0);
-            if (vao_ != 0) {
-                glBindVertexArray(vao_);
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-                glBindVertexArray(0);
-            } else {
-                glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-                glEnableVertexAttribArray(posLoc_);
-                glVertexAttribPointer(posLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
-                glEnableVertexAttribArray(texCoordLoc_);
-                glVertexAttribPointer(texCoordLoc_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
-                                      reinterpret_cast<void*>(2 * sizeof(float)));
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-                glDisableVertexAttribArray(posLoc_);
-                glDisableVertexAttribArray(texCoordLoc_);
-                glBindBuffer(GL_ARRAY_BUFFER, 0);
-            }
-            glBindTexture(GL_TEXTURE_2D, 0);
+            ScreenMapping mapping = calcMapping(surfaceWidth_, surfaceHeight_, vncWidth_, vncHeight_,
+                                                view.zoom, view.panX, view.panY);
+            drawTiles(mapping, DamageRect{0, 0, surfaceWidth_, surfaceHeight_}, surfaceWidth_, surfaceHeight_);
         }
-
         eglSwapBuffers(eglDisplay_, eglSurface_);
     }
 
     // Release context from JS thread — render thread will take ownership
     eglMakeCurrent(eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 
+    // Display vsync drives the render loop; without it we fall back to timed pacing
+    OH_NativeVSync* vsync = vsync_.load();
+    if (vsync == nullptr) {
+        static const char VSYNC_NAME[] = "hish_vnc";
+        vsync = OH_NativeVSync_Create(VSYNC_NAME, sizeof(VSYNC_NAME) - 1);
+        vsync_.store(vsync);
+        if (vsync == nullptr) {
+            OH_LOG_WARN(LOG_APP, "OH_NativeVSync_Create failed, using timed pacing");
+        }
+    }
+    if (vsync != nullptr) {
+        // The display (and its refresh rate) may differ from the last window
+        long long period = 0;
+        vsyncPeriodNs_ = OH_NativeVSync_GetPeriod(vsync, &period) == 0 && period > 0 ? period : 0;
+        OH_LOG_INFO(LOG_APP, "VSync pacing enabled: period=%{public}lldns", vsyncPeriodNs_);
+    }
+    vsyncPaced_.store(vsync != nullptr, std::memory_order_release);
     initialized_.store(true, std::memory_order_release);
 
     // Start render thread
     renderRunning_.store(true, std::memory_order_release);
     renderThread_ = std::thread(renderLoop);
 
-    OH_LOG_INFO(LOG_APP, "VNC renderer initialized: fb=%{public}dx%{public}d, surface=%{public}dx%{public}d",
-                vncWidth_, vncHeight_, surfaceWidth_, surfaceHeight_);
+    OH_LOG_INFO(LOG_APP, "VNC renderer initialized: fb=%{public}dx%{public}d, surface=%{public}dx%{public}d%{public}s",
+                vncWidth_, vncHeight_, surfaceWidth_, surfaceHeight_, reused ? " (context reused)" : "");
     return true;
 }
 
+void VncRenderer::detachSurface() {
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    if (!initialized_.load(std::memory_order_acquire) || headless_.load(std::memory_order_acquire)) return;
+
+    OH_LOG_INFO(LOG_APP, "VncRenderer::detachSurface");
+    stopRenderThread();
+    releaseSurface();
+    if (!createOffscreenSurface() || !eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_, eglContext_)) {
+        OH_LOG_WARN(LOG_APP, "No offscreen surface for detached context, releasing GL: err=%{public}d",
+                    eglGetError());
+        cleanupGL();
+        return;
+    }
+
+    // Keep serving captures while there is no window; the next init() reattaches
+    eglMakeCurrent(eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    headless_.store(true, std::memory_order_release);
+    renderRunning_.store(true, std::memory_order_release);
+    renderThread_ = std::thread(renderLoop);
+}
+
+bool VncRenderer::initHeadless() {
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    if (initialized_.load(std::memory_order_acquire)) return true;  // either mode serves captures
+    return initHeadlessLocked();
+}
+
+bool VncRenderer::initHeadlessLocked() {
+    OH_LOG_INFO(LOG_APP, "VncRenderer::initHeadless");
+
+    if (!initEGLHeadless()) {
+        return false;
+    }
+    if (!initResources()) {
+        cleanupGL();
+        return false;
+    }
+
+    eglMakeCurrent(eglDisplay_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    headless_.store(true, std::memory_order_release);
+    initialized_.store(true, std::memory_order_release);
+
+    // No vsync source: the render thread wakes only for capture requests
+    renderRunning_.store(true, std::memory_order_release);
+    renderThread_ = std::thread(renderLoop);
+    return true;
+}
+
+bool VncRenderer::captureThumbnail(int maxWidth, int maxHeight, std::vector<uint8_t>& rgba,
+                                   int& width, int& height) {
+    if (maxWidth <= 0 || maxHeight <= 0) return false;
+
+    {
+        std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+        if (!initialized_.load(std::memory_order_acquire) && !initHeadlessLocked()) {
+            return false;
+        }
+    }
+
+    // Not under lifecycleMutex_: surface create/destroy and shutdown go ahead
+    // meanwhile. The render thread they stop fails the request on its way out
+    // (finishCapture), so a running renderer checked here always answers
+    CaptureRequest req = {maxWidth, maxHeight, &rgba, 0, 0, false, false};
+    {
+        std::unique_lock<std::mutex> lk(renderWakeMutex_);
+        captureDoneCv_.wait(lk, [] {
+            return captureRequest_ == nullptr || !renderRunning_.load(std::memory_order_acquire);
+        });
+        if (!renderRunning_.load(std::memory_order_acquire)) return false;
+        captureRequest_ = &req;
+        renderWakeCv_.notify_one();
+        captureDoneCv_.wait(lk, [&req] { return req.done; });
+    }
+
+    width = req.width;
+    height = req.height;
+    return req.ok;
+}
+
+// Render thread: complete (or, when the thread is exiting, fail) the pending capture
+void VncRenderer::finishCapture(bool serviced) {
+    std::lock_guard<std::mutex> lk(renderWakeMutex_);
+    if (captureRequest_ == nullptr) return;
+    if (!serviced) captureRequest_->ok = false;
+    captureRequest_->done = true;
+    captureRequest_ = nullptr;
+    captureDoneCv_.notify_all();
+}
+
+void VncRenderer::serviceCapture(CaptureRequest& req) {
+    ViewTransform view;
+    DamageRegion region;
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex_);
+        view = view_;
+        if (headless_.load(std::memory_order_acquire)) {
+            // Nothing is presented headless: the capture consumes the damage
+            region = dirtyRegion_;
+            dirtyRegion_.clear();
+            dirty_.store(false, std::memory_order_release);
+        }
+    }
+    // All tiles, not just the ones on screen
+    updateTexture(region, false, view, true);
+    if (tiles_.empty() || vncWidth_ <= 0 || vncHeight_ <= 0) return;
+
+    float scale = std::min({1.0f, static_cast<float>(req.maxWidth) / vncWidth_,
+                            static_cast<float>(req.maxHeight) / vncHeight_});
+    int w = std::max(1, static_cast<int>(vncWidth_ * scale));
+    int h = std::max(1, static_cast<int>(vncHeight_ * scale));
+
+    if (captureFbo_ == 0) {
+        glGenFramebuffers(1, &captureFbo_);
+        glGenTextures(1, &captureTex_);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, captureFbo_);
+    if (w != captureWidth_ || h != captureHeight_) {
+        glBindTexture(GL_TEXTURE_2D, captureTex_);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, captureTex_, 0);
+        captureWidth_ = w;
+        captureHeight_ = h;
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        OH_LOG_ERROR(LOG_APP, "Capture FBO incomplete: 0x%{public}x", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
+    glViewport(0, 0, w, h);
+    glClear(GL_COLOR_BUFFER_BIT);
+    ScreenMapping m = {0.0f, 0.0f, static_cast<float>(w) / vncWidth_, DamageRect{0, 0, w, h}};
+    drawTiles(m, m.clip, w, h);
+
+    // GL rows are bottom-up: read, then flip to top row first
+    const size_t rowBytes = static_cast<size_t>(w) * 4;
+    req.rgba->resize(rowBytes * h);
+    uint8_t* data = req.rgba->data();
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::vector<uint8_t> row(rowBytes);
+    for (int y = 0; y < h / 2; y++) {
+        uint8_t* top = data + y * rowBytes;
+        uint8_t* bottom = data + (h - 1 - y) * rowBytes;
+        memcpy(row.data(), top, rowBytes);
+        memcpy(top, bottom, rowBytes);
+        memcpy(bottom, row.data(), rowBytes);
+    }
+
+    req.width = w;
+    req.height = h;
+    req.ok = true;
+}
+
 void VncRenderer::shutdown() {
+    std::lock_guard<std::mutex> lifecycle(lifecycleMutex_);
+    shutdownLocked();
+}
+
+void VncRenderer::shutdownLocked() {
     OH_LOG_INFO(LOG_APP, "VncRenderer::shutdown");
 
-    // Stop render thread first
+    stopRenderThread();
+    if (!initialized_.load(std::memory_order_acquire)) return;
+
+    // Now safe to cleanup — no other thread touches GL
+    cleanupGL();
+}
+
+void VncRenderer::stopRenderThread() {
     renderRunning_.store(false, std::memory_order_release);
-    renderWakeCv_.notify_one();
+    wakeRenderThread();
     if (renderThread_.joinable()) {
         renderThread_.join();
     }
 
-    if (!initialized_.load(std::memory_order_acquire)) return;
-
-    // Now safe to cleanup — no other thread touches GL
-    if (eglDisplay_ != EGL_NO_DISPLAY && eglSurface_ != nullptr && eglContext_ != nullptr) {
-        eglMakeCurrent(eglDisplay_, eglSurface_, eglSurface_, eglContext_);
-    }
-    cleanupGL();
+    // vsync_ itself stays: producers may be requesting a frame right now
+    vsyncPaced_.store(false, std::memory_order_release);
+    vsyncRequested_.store(false, std::memory_order_release);
+    vsyncTick_.store(false, std::memory_order_release);
 }
 
 void VncRenderer::resize(int width, int height) {
@@ -750,18 +1849,15 @@ void VncRenderer::resize(int width, int height) {
 
     surfaceResized_.store(true, std::memory_order_release);
 
-    int vw, vh;
-    {
-        std::lock_guard<std::mutex> lock(VncClient::getFbMutex());
-        vw = VncClient::getFrameWidth();
-        vh = VncClient::getFrameHeight();
-    }
+    bool bridge = DisplayBridge::isActive();
+    int vw = bridge ? DisplayBridge::getFrameWidth() : VncClient::getFrameWidth();
+    int vh = bridge ? DisplayBridge::getFrameHeight() : VncClient::getFrameHeight();
     if (vw > 0 && vh > 0) {
         markDirty(0, 0, vw, vh);
     } else {
         dirty_.store(true, std::memory_order_release);
     }
 
-    renderWakeCv_.notify_one();
+    requestFrame();
     OH_LOG_INFO(LOG_APP, "resize: surfaceResized flagged, vnc=%{public}dx%{public}d", vw, vh);
 }
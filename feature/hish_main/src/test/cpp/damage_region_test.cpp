@@ -0,0 +1,110 @@
+//
+// Damage Region Tests for HiSH
+//
+
+#include "include/damage_region.hpp"
+#include <gtest/gtest.h>
+
+namespace {
+
+bool disjoint(const DamageRegion& region) {
+    for (int i = 0; i < region.size(); i++) {
+        for (int j = i + 1; j < region.size(); j++) {
+            if (region[i].intersects(region[j])) return false;
+        }
+    }
+    return true;
+}
+
+bool covered(const DamageRegion& region, const DamageRect& r) {
+    int64_t inside = 0;
+    for (const DamageRect& d : region) {
+        inside += d.intersection(r).area();
+    }
+    return inside == r.area();
+}
+
+} // namespace
+
+TEST(DamageRegion, IgnoresEmptyRects) {
+    DamageRegion region;
+    region.add(10, 10, 0, 5);
+    region.add(10, 10, 5, -1);
+    EXPECT_TRUE(region.empty());
+}
+
+TEST(DamageRegion, ContainedRectIsAbsorbed) {
+    DamageRegion region;
+    region.add(0, 0, 100, 100);
+    region.add(10, 10, 20, 20);
+    ASSERT_EQ(region.size(), 1);
+    EXPECT_EQ(region.area(), 100 * 100);
+}
+
+TEST(DamageRegion, NeighboursMergeIntoBoundingBox) {
+    DamageRegion region;
+    region.add(0, 0, 10, 10);
+    region.add(5, 5, 10, 10);
+    ASSERT_EQ(region.size(), 1);
+    DamageRect b = region.bounds();
+    EXPECT_EQ(b.x, 0);
+    EXPECT_EQ(b.y, 0);
+    EXPECT_EQ(b.w, 15);
+    EXPECT_EQ(b.h, 15);
+}
+
+TEST(DamageRegion, DistantRectsStaySeparate) {
+    DamageRegion region;
+    region.add(0, 0, 100, 100);
+    region.add(1000, 1000, 100, 100);
+    ASSERT_EQ(region.size(), 2);
+    EXPECT_EQ(region.area(), 2 * 100 * 100);
+}
+
+TEST(DamageRegion, OverlapsAreSplitWithoutDoubleCounting) {
+    DamageRegion region;
+    region.add(0, 0, 400, 100);
+    region.add(300, 0, 100, 400);
+    EXPECT_TRUE(disjoint(region));
+    EXPECT_TRUE(covered(region, {0, 0, 400, 100}));
+    EXPECT_TRUE(covered(region, {300, 0, 100, 400}));
+    EXPECT_LE(region.area(), 400 * 400);
+}
+
+TEST(DamageRegion, CapsAtMaxRectsAndKeepsCoverage) {
+    DamageRegion region;
+    DamageRect added[64];
+    for (int i = 0; i < 64; i++) {
+        added[i] = {(i % 8) * 300, (i / 8) * 300, 20, 20};
+        region.add(added[i]);
+        ASSERT_LE(region.size(), DamageRegion::MAX_RECTS);
+        ASSERT_TRUE(disjoint(region));
+    }
+    EXPECT_EQ(region.size(), DamageRegion::MAX_RECTS);
+    for (const DamageRect& r : added) {
+        EXPECT_TRUE(covered(region, r));
+    }
+}
+
+TEST(DamageRegion, AddRegionMergesAllRects) {
+    DamageRegion a;
+    DamageRegion b;
+    a.add(0, 0, 50, 50);
+    b.add(2000, 0, 50, 50);
+    b.add(0, 2000, 50, 50);
+    a.add(b);
+    EXPECT_EQ(a.size(), 3);
+    EXPECT_EQ(a.area(), 3 * 50 * 50);
+}
+
+TEST(DamageRegion, ClipDropsRectsOutside) {
+    DamageRegion region;
+    region.add(-10, -10, 30, 30);
+    region.add(5000, 5000, 10, 10);
+    region.clip(640, 480);
+    ASSERT_EQ(region.size(), 1);
+    EXPECT_EQ(region[0].x, 0);
+    EXPECT_EQ(region[0].y, 0);
+    EXPECT_EQ(region[0].w, 20);
+    EXPECT_EQ(region[0].h, 20);
+}
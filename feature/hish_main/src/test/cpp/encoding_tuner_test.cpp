@@ -0,0 +1,136 @@
+//
+// Encoding Tuner Tests for HiSH
+//
+
+#include "include/encoding_tuner.hpp"
+#include <gtest/gtest.h>
+
+// Drives decide() window by window, as onUpdate() would on a TCP link
+class EncodingTunerTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t MIN_RTT_US = 10000;
+    static constexpr uint32_t QUEUED_RTT_US = 50000;
+    static constexpr double FAST_DECODE = 1000.0;
+    static constexpr double SLOW_DECODE = EncodingTuner::CPU_BOUND_US_PER_MPX * 2;
+
+    EncodingTuner tuner;
+
+    void SetUp() override { tuner.reset(false); }
+
+    int window(uint32_t rttUs, double kbps, double decodeUsPerMpx) {
+        tuner.profile_ = tuner.decide(rttUs, MIN_RTT_US, kbps, decodeUsPerMpx);
+        return tuner.profile_;
+    }
+    int queued(double kbps = 1000.0) { return window(QUEUED_RTT_US, kbps, FAST_DECODE); }
+    int idle(double kbps = 100.0) { return window(MIN_RTT_US, kbps, FAST_DECODE); }
+    int cpuBound() { return window(MIN_RTT_US, 100.0, SLOW_DECODE); }
+
+    // Sit out the hold after a change without moving anything
+    void hold() {
+        for (int i = 0; i < EncodingTuner::HOLD_WINDOWS; i++) {
+            int profile = tuner.profile_;
+            int quality = tuner.quality_;
+            ASSERT_EQ(queued(), profile);
+            ASSERT_EQ(tuner.quality_, quality);
+        }
+    }
+
+    int profile() const { return tuner.profile_; }
+    int quality() const { return tuner.qualityLevel(); }
+    int maxProfile() const { return tuner.maxProfile_; }
+    static int minQuality() { return EncodingTuner::MIN_QUALITY; }
+    static int maxQuality() { return EncodingTuner::MAX_QUALITY; }
+    static int lockoutWindows() { return EncodingTuner::DOWN_LOCKOUT_WINDOWS; }
+};
+
+TEST_F(EncodingTunerTest, LocalLinksStartOnRaw) {
+    tuner.reset(true);
+    EXPECT_STREQ(tuner.profile().name, "raw");
+    EXPECT_TRUE(tuner.stats().local);
+    EXPECT_FALSE(tuner.stats().tuned);
+}
+
+TEST_F(EncodingTunerTest, QueueingStepsUpThenHolds) {
+    int start = profile();
+    ASSERT_LT(start, maxProfile());
+    EXPECT_EQ(queued(), start + 1);
+    hold();
+}
+
+TEST_F(EncodingTunerTest, CpuBoundStepsDown) {
+    int start = profile();
+    EXPECT_EQ(cpuBound(), start - 1);
+    hold();
+    EXPECT_EQ(cpuBound(), start - 2);
+}
+
+TEST_F(EncodingTunerTest, IdleLinkStaysPut) {
+    int start = profile();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(idle(), start);
+    }
+}
+
+TEST_F(EncodingTunerTest, StepDownUndoneByQueueingLocksOutFurtherStepDowns) {
+    int start = profile();
+    ASSERT_EQ(cpuBound(), start - 1);
+    hold();
+    ASSERT_EQ(queued(), start);
+    hold();
+    // Still CPU bound, but stepping down again would only queue again
+    for (int i = 0; i < lockoutWindows() - 1; i++) {
+        ASSERT_EQ(cpuBound(), start);
+    }
+    EXPECT_EQ(cpuBound(), start - 1);
+}
+
+TEST_F(EncodingTunerTest, QualityOnlyMovesOnLossyProfile) {
+    ASSERT_FALSE(tuner.profile().lossy);
+    int start = quality();
+    for (int i = 0; i < 5; i++) {
+        idle();
+    }
+    EXPECT_EQ(quality(), start);
+}
+
+TEST_F(EncodingTunerTest, QueueingOnTightLowersQualityToFloor) {
+    while (profile() < maxProfile()) {
+        queued();
+        hold();
+    }
+    ASSERT_TRUE(tuner.profile().lossy);
+    int last = quality();
+    while (last > minQuality()) {
+        EXPECT_EQ(queued(), maxProfile());
+        EXPECT_LT(quality(), last);
+        last = quality();
+        hold();
+    }
+    EXPECT_EQ(quality(), minQuality());
+    queued();
+    EXPECT_EQ(quality(), minQuality());
+}
+
+TEST_F(EncodingTunerTest, QualityRecoversOnlyBelowMeasuredCapacity) {
+    while (profile() < maxProfile()) {
+        queued();
+        hold();
+    }
+    // Link saturates at 1000 kbps
+    queued(1000.0);
+    hold();
+    int low = quality();
+
+    // Near capacity: no room for more bytes per frame
+    idle(900.0);
+    EXPECT_EQ(quality(), low);
+
+    // Well below it: one level per window, up to the ceiling
+    for (int level = low + 1; level <= maxQuality(); level++) {
+        idle(100.0);
+        EXPECT_EQ(quality(), level);
+        hold();
+    }
+    idle(100.0);
+    EXPECT_EQ(quality(), maxQuality());
+}
@@ -0,0 +1,150 @@
+//
+// Frame Exchange Tests for HiSH
+//
+
+#include "include/frame_exchange.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+constexpr int W = 64;
+constexpr int H = 32;
+constexpr int BPP = 4;
+
+void fill(uint8_t* fb, const DamageRect& r, uint8_t value) {
+    for (int y = r.y; y < r.y + r.h; y++) {
+        memset(fb + (static_cast<size_t>(y) * W + r.x) * BPP, value, static_cast<size_t>(r.w) * BPP);
+    }
+}
+
+DamageRegion damage(const DamageRect& r) {
+    DamageRegion region;
+    region.add(r);
+    return region;
+}
+
+} // namespace
+
+TEST(FrameExchange, NothingToAcquireBeforePublish) {
+    FrameExchange frames;
+    EXPECT_EQ(frames.acquire(), nullptr);
+    ASSERT_NE(frames.resize(W, H, BPP), nullptr);
+    EXPECT_EQ(frames.acquire(), nullptr);
+    EXPECT_EQ(frames.published(), 0u);
+}
+
+TEST(FrameExchange, PublishHandsOverCompleteFrame) {
+    FrameExchange frames;
+    uint8_t* back = frames.resize(W, H, BPP);
+    fill(back, {0, 0, W, H}, 0x11);
+    uint8_t* next = frames.publish(damage({0, 0, W, H}));
+    ASSERT_NE(next, nullptr);
+    EXPECT_NE(next, back);
+
+    const VncFrame* frame = frames.acquire();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->data, back);
+    EXPECT_EQ(frame->seq, 1u);
+    EXPECT_EQ(frame->width, W);
+    EXPECT_EQ(frame->stride, static_cast<size_t>(W) * BPP);
+    frames.release();
+}
+
+TEST(FrameExchange, NewBackBufferCatchesUpWithDamage) {
+    FrameExchange frames;
+    uint8_t* back = frames.resize(W, H, BPP);
+    fill(back, {0, 0, W, H}, 0x11);
+    back = frames.publish(damage({0, 0, W, H}));
+
+    // Each slot coming back must hold the newest published pixels
+    const DamageRect rects[] = {{4, 4, 8, 8}, {40, 2, 10, 20}, {0, 30, W, 2}, {20, 10, 5, 5}};
+    uint8_t expected[W * H * BPP];
+    memset(expected, 0x11, sizeof(expected));
+    uint8_t value = 0x20;
+    for (const DamageRect& r : rects) {
+        ASSERT_EQ(memcmp(back, expected, sizeof(expected)), 0);
+        fill(back, r, value);
+        fill(expected, r, value);
+        back = frames.publish(damage(r));
+        value++;
+
+        const VncFrame* frame = frames.acquire();
+        ASSERT_NE(frame, nullptr);
+        EXPECT_EQ(memcmp(frame->data, expected, sizeof(expected)), 0);
+        frames.release();
+    }
+    EXPECT_EQ(memcmp(back, expected, sizeof(expected)), 0);
+}
+
+TEST(FrameExchange, ConsumerGetsNewestFrameAndSkipsOlder) {
+    FrameExchange frames;
+    frames.resize(W, H, BPP);
+    frames.publish(damage({0, 0, W, H}));
+    frames.publish(damage({0, 0, 1, 1}));
+    frames.publish(damage({0, 0, 1, 1}));
+    EXPECT_EQ(frames.published(), 3u);
+    EXPECT_EQ(frames.unconsumed(), 3u);
+
+    const VncFrame* frame = frames.acquire();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->seq, 3u);
+    frames.release();
+    EXPECT_EQ(frames.unconsumed(), 0u);
+
+    // Nothing fresher: the same frame again
+    frame = frames.acquire();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->seq, 3u);
+    frames.release();
+}
+
+TEST(FrameExchange, WaitConsumedWakesOnAcquire) {
+    FrameExchange frames;
+    frames.resize(W, H, BPP);
+    frames.publish(damage({0, 0, W, H}));
+    EXPECT_FALSE(frames.waitConsumed(1, 10));
+
+    std::thread consumer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        if (frames.acquire()) frames.release();
+    });
+    EXPECT_TRUE(frames.waitConsumed(1, 5000));
+    consumer.join();
+}
+
+TEST(FrameExchange, ResetWaitsForConsumerAndStartsOver) {
+    FrameExchange frames;
+    frames.resize(W, H, BPP);
+    frames.publish(damage({0, 0, W, H}));
+    ASSERT_NE(frames.acquire(), nullptr);
+
+    std::atomic<bool> done{false};
+    std::thread resetter([&] {
+        frames.reset();
+        done.store(true);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(done.load());
+    frames.release();
+    resetter.join();
+
+    EXPECT_EQ(frames.published(), 0u);
+    EXPECT_EQ(frames.backBuffer(), nullptr);
+    EXPECT_EQ(frames.acquire(), nullptr);
+    ASSERT_NE(frames.resize(W, H, BPP), nullptr);
+    frames.publish(damage({0, 0, W, H}));
+    const VncFrame* frame = frames.acquire();
+    ASSERT_NE(frame, nullptr);
+    EXPECT_EQ(frame->seq, 1u);
+    frames.release();
+}
+
+TEST(FrameExchange, ShrinkReusesMapping) {
+    FrameExchange frames;
+    uint8_t* big = frames.resize(W * 2, H * 2, BPP);
+    EXPECT_EQ(frames.resize(W, H, BPP), big);
+}
@@ -0,0 +1,173 @@
+//
+// Input Queue Tests for HiSH
+//
+
+#include "include/input_queue.hpp"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+InputEvent pointer(int32_t x, int32_t y, int32_t buttonMask) {
+    InputEvent ev = {};
+    ev.type = InputEvent::Pointer;
+    ev.x = x;
+    ev.y = y;
+    ev.buttonMask = buttonMask;
+    return ev;
+}
+
+InputEvent key(uint32_t keysym, bool down) {
+    InputEvent ev = {};
+    ev.type = InputEvent::Key;
+    ev.key = keysym;
+    ev.down = down;
+    return ev;
+}
+
+// Everything the writer would send for `in`, flushing motion at the end
+std::vector<InputEvent> coalesce(const std::vector<InputEvent>& in) {
+    MotionCoalescer coalescer;
+    std::vector<InputEvent> sent;
+    for (const InputEvent& ev : in) {
+        InputEvent out[2];
+        int n = coalescer.feed(ev, out);
+        sent.insert(sent.end(), out, out + n);
+    }
+    InputEvent motion;
+    if (coalescer.flush(motion)) sent.push_back(motion);
+    return sent;
+}
+
+} // namespace
+
+TEST(InputQueue, PopsInPushOrder) {
+    InputQueue queue;
+    InputEvent ev;
+    EXPECT_FALSE(queue.pop(ev));
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(queue.push(pointer(i, 0, i % 2)));
+    }
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(queue.pop(ev));
+        EXPECT_EQ(ev.x, i);
+        EXPECT_EQ(ev.buttonMask, i % 2);
+    }
+    EXPECT_FALSE(queue.pop(ev));
+}
+
+TEST(InputQueue, RejectsPushWhenFull) {
+    InputQueue queue;
+    for (size_t i = 0; i < InputQueue::CAPACITY; i++) {
+        ASSERT_TRUE(queue.push(pointer(static_cast<int32_t>(i), 0, 0)));
+    }
+    EXPECT_FALSE(queue.push(pointer(-1, 0, 0)));
+
+    InputEvent ev;
+    ASSERT_TRUE(queue.pop(ev));
+    EXPECT_EQ(ev.x, 0);
+    EXPECT_TRUE(queue.push(pointer(-1, 0, 0)));
+}
+
+TEST(InputQueue, WrapsAroundManyLaps) {
+    InputQueue queue;
+    InputEvent ev;
+    for (int i = 0; i < static_cast<int>(InputQueue::CAPACITY) * 10; i++) {
+        ASSERT_TRUE(queue.push(pointer(i, 0, 0)));
+        ASSERT_TRUE(queue.pop(ev));
+        ASSERT_EQ(ev.x, i);
+    }
+}
+
+// Events of one producer, press/release transitions included, come out in
+// the order it pushed them, whatever the other producers do
+TEST(InputQueue, KeepsPerProducerOrderUnderContention) {
+    constexpr int PRODUCERS = 4;
+    constexpr int EVENTS = 20000;
+    InputQueue queue;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&queue, p] {
+            for (int i = 0; i < EVENTS; i++) {
+                // Button 1 toggles on every event: each one is a transition
+                while (!queue.push(pointer(p, i, i & 1))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    int next[PRODUCERS] = {};
+    int received = 0;
+    InputEvent ev;
+    while (received < PRODUCERS * EVENTS) {
+        if (!queue.pop(ev)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_GE(ev.x, 0);
+        ASSERT_LT(ev.x, PRODUCERS);
+        ASSERT_EQ(ev.y, next[ev.x]);
+        ASSERT_EQ(ev.buttonMask, ev.y & 1);
+        next[ev.x]++;
+        received++;
+    }
+    for (std::thread& t : producers) {
+        t.join();
+    }
+    EXPECT_FALSE(queue.pop(ev));
+}
+
+TEST(MotionCoalescer, KeepsOnlyLatestMotion) {
+    MotionCoalescer coalescer;
+    InputEvent out[2];
+    ASSERT_EQ(coalescer.feed(pointer(0, 0, 0), out), 1);   // first mask is a transition
+    for (int i = 1; i <= 5; i++) {
+        EXPECT_EQ(coalescer.feed(pointer(i, i, 0), out), 0);
+    }
+    EXPECT_TRUE(coalescer.pending());
+    EXPECT_EQ(coalescer.coalesced(), 4u);
+
+    InputEvent motion;
+    ASSERT_TRUE(coalescer.flush(motion));
+    EXPECT_EQ(motion.x, 5);
+    EXPECT_FALSE(coalescer.pending());
+    EXPECT_FALSE(coalescer.flush(motion));
+}
+
+TEST(MotionCoalescer, PreservesButtonTransitions) {
+    // Drag: move, press, move, move, release, move
+    std::vector<InputEvent> sent = coalesce({
+        pointer(1, 1, 0), pointer(2, 2, 0), pointer(3, 3, 1), pointer(4, 4, 1),
+        pointer(5, 5, 1), pointer(6, 6, 0), pointer(7, 7, 0),
+    });
+    const int32_t expected[][2] = {{1, 0}, {2, 0}, {3, 1}, {5, 1}, {6, 0}, {7, 0}};
+    ASSERT_EQ(sent.size(), sizeof(expected) / sizeof(expected[0]));
+    for (size_t i = 0; i < sent.size(); i++) {
+        EXPECT_EQ(sent[i].x, expected[i][0]) << "event " << i;
+        EXPECT_EQ(sent[i].buttonMask, expected[i][1]) << "event " << i;
+    }
+}
+
+TEST(MotionCoalescer, QuickClickIsNotMerged) {
+    std::vector<InputEvent> sent = coalesce({
+        pointer(10, 10, 0), pointer(10, 10, 1), pointer(10, 10, 0),
+    });
+    ASSERT_EQ(sent.size(), 3u);
+    EXPECT_EQ(sent[1].buttonMask, 1);
+    EXPECT_EQ(sent[2].buttonMask, 0);
+}
+
+TEST(MotionCoalescer, KeyFlushesPendingMotionFirst) {
+    std::vector<InputEvent> sent = coalesce({
+        pointer(1, 1, 0), pointer(2, 2, 0), pointer(3, 3, 0), key(0x61, true), pointer(4, 4, 0),
+    });
+    ASSERT_EQ(sent.size(), 4u);
+    EXPECT_EQ(sent[1].type, InputEvent::Pointer);
+    EXPECT_EQ(sent[1].x, 3);
+    EXPECT_EQ(sent[2].type, InputEvent::Key);
+    EXPECT_EQ(sent[2].key, 0x61u);
+    EXPECT_EQ(sent[3].x, 4);
+}
@@ -0,0 +1,104 @@
+//
+// Render Statistics Tests for HiSH
+//
+
+#include "include/render_stats.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// Every counter set to the same value, so a torn read shows up as columns
+// that disagree
+FrameStats uniform(uint32_t value) {
+    FrameStats f = {};
+    f.timestampMs = value * 10;
+    f.uploadBytes = value;
+    f.uploadRects = value;
+    f.uploadUs = value;
+    f.gpuUs = value;
+    f.swapUs = value;
+    f.frameUs = value;
+    f.coalesced = 1;
+    return f;
+}
+
+bool same(const StatPercentiles& a, const StatPercentiles& b) {
+    return a.p50 == b.p50 && a.p95 == b.p95 && a.p99 == b.p99 && a.max == b.max;
+}
+
+} // namespace
+
+TEST(RenderStatsRing, EmptySummary) {
+    RenderStatsRing ring;
+    RenderStatsSummary s = ring.summarize();
+    EXPECT_EQ(s.frames, 0u);
+    EXPECT_EQ(s.fps, 0.0f);
+    EXPECT_FALSE(s.gpuTiming);
+}
+
+TEST(RenderStatsRing, PercentilesAndFps) {
+    RenderStatsRing ring;
+    for (uint32_t i = 1; i <= 100; i++) {
+        ring.push(uniform(i));
+    }
+    RenderStatsSummary s = ring.summarize();
+    EXPECT_EQ(s.frames, 100u);
+    EXPECT_EQ(s.frameUs.p50, 51u);
+    EXPECT_EQ(s.frameUs.p95, 96u);
+    EXPECT_EQ(s.frameUs.p99, 100u);
+    EXPECT_EQ(s.frameUs.max, 100u);
+    EXPECT_FLOAT_EQ(s.fps, 100.0f);
+    EXPECT_EQ(s.coalescedTotal, 100u);
+}
+
+TEST(RenderStatsRing, KeepsOnlyTheNewestCapacityFrames) {
+    RenderStatsRing ring;
+    const uint32_t total = RenderStatsRing::CAPACITY + 44;
+    for (uint32_t i = 1; i <= total; i++) {
+        ring.push(uniform(i));
+    }
+    RenderStatsSummary s = ring.summarize();
+    EXPECT_EQ(s.frames, static_cast<uint32_t>(RenderStatsRing::CAPACITY));
+    EXPECT_EQ(s.frameUs.max, total);
+    EXPECT_EQ(s.frameUs.p50, 45u + RenderStatsRing::CAPACITY / 2);
+}
+
+TEST(RenderStatsRing, GpuPercentilesOnlyOverMeasuredFrames) {
+    RenderStatsRing ring;
+    for (uint32_t i = 1; i <= 10; i++) {
+        FrameStats f = uniform(i);
+        f.gpuUs = i % 2 == 0 ? 1000 : 0;
+        ring.push(f);
+    }
+    RenderStatsSummary s = ring.summarize();
+    EXPECT_TRUE(s.gpuTiming);
+    EXPECT_EQ(s.gpuUs.p50, 1000u);
+    EXPECT_EQ(s.gpuUs.max, 1000u);
+}
+
+TEST(RenderStatsRing, ClearDropsFrames) {
+    RenderStatsRing ring;
+    ring.push(uniform(1));
+    ring.clear();
+    EXPECT_EQ(ring.summarize().frames, 0u);
+}
+
+TEST(RenderStatsRing, ReaderNeverSeesTornFrames) {
+    RenderStatsRing ring;
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        for (uint32_t i = 1; !stop.load(); i++) {
+            ring.push(uniform(i));
+        }
+    });
+    for (int round = 0; round < 2000; round++) {
+        RenderStatsSummary s = ring.summarize();
+        ASSERT_TRUE(same(s.uploadBytes, s.frameUs));
+        ASSERT_TRUE(same(s.uploadUs, s.swapUs));
+        ASSERT_EQ(s.coalescedTotal, s.frames);
+    }
+    stop.store(true);
+    writer.join();
+}